@@ -1,6 +1,7 @@
 #pragma once
 
 #include <eosio/asset.hpp>
+#include <eosio/crypto.hpp>
 #include <eosio/privileged.hpp>
 #include <eosio/singleton.hpp>
 #include <eosio/system.hpp>
@@ -31,6 +32,84 @@ namespace NodeStatus {
    static constexpr eosio::name DISABLE{ "disable"_n };
 } // namespace NodeStatus
 
+namespace PriceCurve {
+   static constexpr eosio::name FIXED{ "fixed"_n };             // node_t::price for every unit
+   static constexpr eosio::name TIERS{ "tiers"_n };             // tier amount by total_saled
+   static constexpr eosio::name LINEAR{ "linear"_n };           // base + step * n
+   static constexpr eosio::name EXPONENTIAL{ "exponential"_n }; // base * (1 + rate / RATIO_BOOST) ^ n
+} // namespace PriceCurve
+
+namespace RamPayer {
+   static constexpr eosio::name SELF{ "self"_n }; // the contract pays for every row
+   static constexpr eosio::name USER{ "user"_n }; // a buyer with its authority present pays for its rows
+} // namespace RamPayer
+
+// billable overhead of one table row on top of its packed data
+static constexpr uint64_t ROW_RAM_OVERHEAD = 112;
+
+// deepest ancestor level a team aggregate update may reach
+static constexpr uint8_t MAX_TEAM_DEPTH = 16;
+
+// most units one preorder may ask for, bounds the work of allocating it
+static constexpr uint64_t MAX_PREORDER_UNITS = 10;
+
+// most units one buy action may ask for
+static constexpr uint64_t MAX_BUY_UNITS = 10;
+
+// commission rates are fractions of RATIO_BOOST, paid to at most MAX_COMMISSION_LEVELS ancestors
+static constexpr uint16_t RATIO_BOOST           = 10000;
+static constexpr uint8_t  MAX_COMMISSION_LEVELS = 5;
+
+// most tiers of a tiered pricing
+static constexpr uint8_t MAX_PRICE_TIERS = 16;
+
+// most shard accounts a coordinator routes users to
+static constexpr uint8_t MAX_SHARDS = 32;
+
+// voucher nonces tracked by one voucherbits row
+static constexpr uint64_t VOUCHER_BATCH_BITS = 256;
+
+// stat bucket widths in seconds
+static constexpr uint32_t HOUR_SECONDS = 3600;
+static constexpr uint32_t DAY_SECONDS  = 24 * HOUR_SECONDS;
+
+namespace EventType {
+   static constexpr eosio::name ADDNODE{ "addnode"_n };
+   static constexpr eosio::name SETNODE{ "setnode"_n };
+   static constexpr eosio::name DELNODE{ "delnode"_n };
+   static constexpr eosio::name SETTOTALSALE{ "settotalsale"_n };
+   static constexpr eosio::name SETNODESTATE{ "setnodestate"_n };
+   static constexpr eosio::name SETPRICING{ "setpricing"_n }; // price curve set or removed, the curve is in the pricings table
+   static constexpr eosio::name RECONCILE{ "reconcile"_n };
+   static constexpr eosio::name SIGNUP{ "signup"_n };
+   static constexpr eosio::name SIGNBIND{ "signbind"_n };
+   static constexpr eosio::name SIGNEDIT{ "signedit"_n };
+   static constexpr eosio::name SIGNDEL{ "signdel"_n };
+   static constexpr eosio::name INVITE{ "invite"_n }; // inviter row changed by another user's event
+   static constexpr eosio::name BUY{ "buy"_n };
+   static constexpr eosio::name ADDORDER{ "addorder"_n };
+   static constexpr eosio::name DELORDER{ "delorder"_n };
+   static constexpr eosio::name ARCHIVE{ "archive"_n }; // order folded into the node accumulator and erased
+   static constexpr eosio::name PREORDER{ "preorder"_n }; // order allocated to a queued preorder
+   static constexpr eosio::name REDEEM{ "redeem"_n };     // order redeemed from an admin signed voucher
+} // namespace EventType
+
+static constexpr uint8_t EVENT_VERSION = 2;
+
+namespace ReconPhase {
+   static constexpr eosio::name NONE{ "none"_n };
+   static constexpr eosio::name CLEAR{ "clear"_n };
+   static constexpr eosio::name COUNT{ "count"_n };
+   static constexpr eosio::name NODES{ "nodes"_n };
+   static constexpr eosio::name INVITES{ "invites"_n };
+   static constexpr eosio::name DONE{ "done"_n };
+} // namespace ReconPhase
+
+namespace ReconScope {
+   static constexpr eosio::name NODE{ "node"_n };       // tally of orders by node id
+   static constexpr eosio::name INVITER{ "inviter"_n }; // tally of invitees by inviter
+} // namespace ReconScope
+
 /// global table
 GLOBAL_TBL("global") global_t {
    name     admin;             // admin account
@@ -46,6 +125,90 @@ GLOBAL_TBL("global") global_t {
 
 typedef eosio::singleton<"global"_n, global_t> global_singleton;
 
+/// config table, runtime settings of the admin
+// kept out of global_t, whose serialized layout deployed contracts already store
+GLOBAL_TBL("config") config_t {
+   bool        event_log      = false;           // emit nodelog, invitelog and orderlog inline actions
+   uint32_t    eligible_ttl   = 0;               // seconds an inviter eligibility stays cached, 0 disables the cache
+   bool        portfolio      = false;           // holdings are kept in portfolios instead of per-user nodetotals
+   name        ram_payer      = RamPayer::SELF;  // payer policy of order and holding rows
+   uint32_t    archive_delay  = 0;               // seconds after creation an order is settled and may be archived, 0 disables archival
+   uint8_t     team_depth     = 0;               // ancestor levels kept in team aggregates, 0 disables them
+   uint32_t    stat_retention = 7 * DAY_SECONDS; // hourly stats older than this are rolled into daily ones
+   public_key  voucher_key;                      // key signing purchase vouchers, vouchers are off while it is empty
+   checksum256 voucher_chain;                    // chain id vouchers must name, set with the key
+
+   EOSLIB_SERIALIZE(config_t, (event_log)(eligible_ttl)(portfolio)(ram_payer)(archive_delay)(team_depth)(stat_retention)(voucher_key)(voucher_chain))
+};
+
+typedef eosio::singleton<"config"_n, config_t> config_singleton;
+
+/// shard config table, routing of users over the shard accounts of a coordinator
+// kept in its own singleton, only actions that route users or sync nodes decode the shard list
+GLOBAL_TBL("shardconf") shard_conf_t {
+   name         coordinator; // account granting node quotas, itself on the coordinator, empty when not sharded
+   vector<name> shards;      // shard accounts in routing order, see shard_index
+
+   EOSLIB_SERIALIZE(shard_conf_t, (coordinator)(shards))
+};
+
+typedef eosio::singleton<"shardconf"_n, shard_conf_t> shard_conf_singleton;
+
+/// shard index of a user, a splitmix64 mix of the account name so that similar names spread evenly
+inline uint64_t shard_index(const name& user, const uint64_t& shard_count) {
+   uint64_t z = user.value + 0x9e3779b97f4a7c15ULL;
+   z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+   z          = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+   return (z ^ (z >> 31)) % shard_count;
+}
+
+/// reconcile table, progress of the counter reconciliation
+GLOBAL_TBL("reconcile") reconcile_t {
+   name           phase = ReconPhase::NONE; // current phase
+   bool           apply = false;            // write the recounted values back
+   name           user;                     // user cursor of the count phase
+   uint64_t       order_id     = 0;         // order cursor inside the current user
+   uint64_t       key          = 0;         // cursor of the clear and compare phases
+   uint64_t       node_diffs   = 0;         // nodes whose total_saled differs
+   uint64_t       invite_diffs = 0;         // inviters whose invite_count differs
+   time_point_sec started_at;               // begin timestamp
+   time_point_sec updated_at;               // last step timestamp
+
+   EOSLIB_SERIALIZE(reconcile_t, (phase)(apply)(user)(order_id)(key)(node_diffs)(invite_diffs)(started_at)(updated_at))
+};
+
+typedef eosio::singleton<"reconcile"_n, reconcile_t> reconcile_singleton;
+
+/// archive table, cursor of the order archival
+GLOBAL_TBL("archive") archive_t {
+   name           user;         // user cursor, next user to archive
+   uint64_t       order_id = 0; // order cursor inside the current user
+   uint64_t       archived = 0; // archived order count
+   uint64_t       rounds   = 0; // completed passes over every user
+   time_point_sec updated_at;   // last step timestamp
+
+   EOSLIB_SERIALIZE(archive_t, (user)(order_id)(archived)(rounds)(updated_at))
+};
+
+typedef eosio::singleton<"archive"_n, archive_t> archive_singleton;
+
+/// accrual table, payments held for the bank until the next sweep
+// accrued always equals swept plus pending
+GLOBAL_TBL("accrual") accrual_t {
+   uint32_t       sweep_interval  = 0; // seconds between sweeps, 0 forwards every payment inline
+   int64_t        sweep_threshold = 0; // accrued amount that allows an early sweep, 0 disables early sweeps
+   asset          pending;             // accrued and not swept yet
+   asset          accrued;             // every payment accrued so far
+   asset          swept;               // every payment swept to the bank so far
+   uint64_t       sweeps = 0;          // sweep count, also the memo of the sweep transfer
+   time_point_sec last_sweep;          // last sweep timestamp
+   time_point_sec updated_at;          // last accrual or sweep timestamp
+
+   EOSLIB_SERIALIZE(accrual_t, (sweep_interval)(sweep_threshold)(pending)(accrued)(swept)(sweeps)(last_sweep)(updated_at))
+};
+
+typedef eosio::singleton<"accrual"_n, accrual_t> accrual_singleton;
+
 /// node table
 // scope: contract account
 AGPU_TBL node_t {
@@ -69,6 +232,100 @@ AGPU_TBL node_t {
    EOSLIB_SERIALIZE(node_t, (node_id)(price)(max_sale)(total_saled)(status)(start_time)(create_time)(update_time))
 };
 
+/// allowlist table, merkle root of the accounts allowed to buy a node
+// scope: contract account
+// leaves are sha256(pack(allow_entry_t)), parents hash their sorted children
+AGPU_TBL allowlist_t {
+   uint64_t       node_id;     // node id
+   checksum256    root;        // merkle root of the allow entries
+   time_point_sec update_time; // update timestamp
+
+   allowlist_t() {}
+   allowlist_t(const uint64_t& i) : node_id(i) {}
+
+   uint64_t primary_key() const { return node_id; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"allowlists"_n, allowlist_t> tbl_t;
+
+   EOSLIB_SERIALIZE(allowlist_t, (node_id)(root)(update_time))
+};
+
+/// allowlist leaf, an account and the units it may buy
+struct allow_entry_t {
+   name     account; // allowed account
+   uint64_t cap = 0; // max units the account may buy
+
+   EOSLIB_SERIALIZE(allow_entry_t, (account)(cap))
+};
+
+/// allowed table, accounts that proved their allowlist entry
+// scope: node id
+// the row is the claimed marker, an entry can only be proved once
+AGPU_TBL allowed_t {
+   name     account;    // allowed account
+   uint64_t cap    = 0; // max units from the proved entry
+   uint64_t bought = 0; // units bought or preordered so far
+
+   allowed_t() {}
+   allowed_t(const name& n) : account(n) {}
+
+   uint64_t primary_key() const { return account.value; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"alloweds"_n, allowed_t> tbl_t;
+
+   EOSLIB_SERIALIZE(allowed_t, (account)(cap)(bought))
+};
+
+/// price tier, unit price once total_saled reaches from_saled
+struct price_tier_t {
+   uint64_t from_saled = 0; // first unit index of the tier
+   int64_t  amount     = 0; // unit price amount
+
+   EOSLIB_SERIALIZE(price_tier_t, (from_saled)(amount))
+};
+
+/// pricing table, price curve of a node replacing its fixed price
+// scope: contract account
+// unit n (0 based total_saled) costs total(n + 1) - total(n), see agpu.contracts.pricing.hpp
+AGPU_TBL pricing_t {
+   uint64_t             node_id;  // node id
+   name                 curve;    // PriceCurve
+   int64_t              base = 0; // first unit price amount, linear and exponential
+   int64_t              step = 0; // amount added per unit sold, linear
+   uint32_t             rate = 0; // growth per unit sold in RATIO_BOOST, exponential
+   vector<price_tier_t> tiers;    // ascending tiers, the first one starts at 0, tiers
+
+   pricing_t() {}
+   pricing_t(const uint64_t& i) : node_id(i) {}
+
+   uint64_t primary_key() const { return node_id; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"pricings"_n, pricing_t> tbl_t;
+
+   EOSLIB_SERIALIZE(pricing_t, (node_id)(curve)(base)(step)(rate)(tiers))
+};
+
+/// shard quota table, units of a node granted to each shard by the coordinator
+// scope: node id
+// the quotas of a node never add up to more than its max_sale on the coordinator
+AGPU_TBL shard_quota_t {
+   name     shard;     // shard account
+   uint64_t quota = 0; // max_sale of the node on the shard
+
+   shard_quota_t() {}
+   shard_quota_t(const name& n) : shard(n) {}
+
+   uint64_t primary_key() const { return shard.value; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"shardquotas"_n, shard_quota_t> tbl_t;
+
+   EOSLIB_SERIALIZE(shard_quota_t, (shard)(quota))
+};
+
 /// node total table
 // scope: user account
 AGPU_TBL node_total_t {
@@ -88,6 +345,128 @@ AGPU_TBL node_total_t {
    EOSLIB_SERIALIZE(node_total_t, (node_id)(total)(create_time)(update_time))
 };
 
+/// compact node total table, v2 encoding of node_total_t written by new holdings
+// scope: user account
+AGPU_TBL node_total_v2_t {
+   unsigned_int           node_id;     // node id
+   uint64_t               total = 0;   // buy total
+   time_point_sec         update_time; // update timestamp
+   binary_extension<name> ram_payer;   // user paying for the row, absent when the contract pays
+
+   node_total_v2_t() {}
+   node_total_v2_t(const uint64_t& i) : node_id(i) {}
+
+   uint64_t primary_key() const { return node_id.value; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"nodetotals2"_n, node_total_v2_t> tbl_t;
+
+   EOSLIB_SERIALIZE(node_total_v2_t, (node_id)(total)(update_time)(ram_payer))
+};
+
+/// holding of one node inside a portfolio
+struct holding_t {
+   unsigned_int node_id;   // node id
+   uint64_t     total = 0; // buy total
+
+   EOSLIB_SERIALIZE(holding_t, (node_id)(total))
+};
+
+/// portfolio table, every holding of a user in one row
+// scope: contract account
+// replaces the per-user nodetotals scopes once config_t::portfolio is on
+AGPU_TBL portfolio_t {
+   name                   user;        // user account
+   vector<holding_t>      holdings;    // holdings with a non zero total
+   time_point_sec         update_time; // update timestamp
+   binary_extension<name> ram_payer;   // user paying for the row, absent when the contract pays, follows the payer of each update
+
+   portfolio_t() {}
+   portfolio_t(const name& n) : user(n) {}
+
+   uint64_t primary_key() const { return user.value; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"portfolios"_n, portfolio_t> tbl_t;
+
+   EOSLIB_SERIALIZE(portfolio_t, (user)(holdings)(update_time)(ram_payer))
+};
+
+/// ram payer table, live order and holding rows per payer
+// scope: contract account
+// bytes are estimated as packed size plus ROW_RAM_OVERHEAD, erased and resized rows are subtracted
+// the row is billed to its payer and counts itself, legacy encoded rows are not counted
+AGPU_TBL ram_payer_t {
+   name     payer;     // paying account, the contract itself or a user
+   uint64_t rows  = 0; // live rows, this one included
+   uint64_t bytes = 0; // estimated bytes billed
+
+   ram_payer_t() {}
+   ram_payer_t(const name& n) : payer(n) {}
+
+   uint64_t primary_key() const { return payer.value; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"rampayers"_n, ram_payer_t> tbl_t;
+
+   EOSLIB_SERIALIZE(ram_payer_t, (payer)(rows)(bytes))
+};
+
+/// balance table, prepaid usdt deposited for buy actions
+// scope: contract account
+AGPU_TBL balance_t {
+   name           user;        // user account
+   asset          balance;     // deposited and not yet spent or withdrawn
+   time_point_sec update_time; // update timestamp
+
+   balance_t() {}
+   balance_t(const name& n) : user(n) {}
+
+   uint64_t primary_key() const { return user.value; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"balances"_n, balance_t> tbl_t;
+
+   EOSLIB_SERIALIZE(balance_t, (user)(balance)(update_time))
+};
+
+/// commission rate table, share of an order price paid to each inviter level
+// scope: contract account
+// node id 0 holds the default rates of nodes without their own row
+AGPU_TBL commission_rate_t {
+   uint64_t         node_id; // node id, 0 for the default
+   vector<uint16_t> rates;   // rates[i]: share of the ancestor i + 1 levels up, in RATIO_BOOST
+
+   commission_rate_t() {}
+   commission_rate_t(const uint64_t& i) : node_id(i) {}
+
+   uint64_t primary_key() const { return node_id; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"commrates"_n, commission_rate_t> tbl_t;
+
+   EOSLIB_SERIALIZE(commission_rate_t, (node_id)(rates))
+};
+
+/// commission table, commissions accrued by an inviter
+// scope: contract account
+AGPU_TBL commission_t {
+   name           inviter;     // inviter account
+   asset          claimable;   // accrued and not claimed yet
+   asset          claimed;     // claimed so far
+   time_point_sec update_time; // update timestamp
+
+   commission_t() {}
+   commission_t(const name& n) : inviter(n) {}
+
+   uint64_t primary_key() const { return inviter.value; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"commissions"_n, commission_t> tbl_t;
+
+   EOSLIB_SERIALIZE(commission_t, (inviter)(claimable)(claimed)(update_time))
+};
+
 /// invite table
 // scope: contract account
 AGPU_TBL invite_t {
@@ -108,6 +487,59 @@ AGPU_TBL invite_t {
    EOSLIB_SERIALIZE(invite_t, (user)(inviter)(invite_count)(create_time)(update_time))
 };
 
+/// invite rank table, inviters with a non zero invite_count ordered by it
+// scope: contract account
+// a separate table, a secondary index added to invites would miss every existing row
+AGPU_TBL invite_rank_t {
+   name           user;             // inviter account
+   uint64_t       invite_count = 0; // invite count, mirrors invite_t
+   time_point_sec update_time;      // update timestamp
+
+   invite_rank_t() {}
+   invite_rank_t(const name& n) : user(n) {}
+
+   uint64_t primary_key() const { return user.value; }
+   uint64_t scope() const { return 0; }
+
+   // ascending rank is descending invite_count, ties broken by ascending user
+   uint128_t by_rank() const { return (uint128_t(~invite_count) << 64) | user.value; }
+
+   typedef multi_index<"inviteranks"_n, invite_rank_t,
+                       indexed_by<"byrank"_n, const_mem_fun<invite_rank_t, uint128_t, &invite_rank_t::by_rank>>>
+         tbl_t;
+
+   EOSLIB_SERIALIZE(invite_rank_t, (user)(invite_count)(update_time))
+};
+
+/// invite projection, the leading fields of invite_t
+struct invite_inviter_t {
+   name user;    // user account
+   name inviter; // inviter account
+
+   EOSLIB_SERIALIZE(invite_inviter_t, (user)(inviter))
+};
+
+/// team table, members and orders of the referral subtree of a user by level
+// scope: contract account
+// level 1 (index 0) are the direct invitees, levels deeper than config_t::team_depth are not kept
+AGPU_TBL team_t {
+   name             user;           // user account
+   uint64_t         own_orders = 0; // orders bought by the user itself
+   vector<uint64_t> members;        // members[i]: users i + 1 levels below
+   vector<uint64_t> orders;         // orders[i]: orders bought by users i + 1 levels below
+   time_point_sec   update_time;    // update timestamp
+
+   team_t() {}
+   team_t(const name& n) : user(n) {}
+
+   uint64_t primary_key() const { return user.value; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"teams"_n, team_t> tbl_t;
+
+   EOSLIB_SERIALIZE(team_t, (user)(own_orders)(members)(orders)(update_time))
+};
+
 /// order table
 // scope: user account
 AGPU_TBL order_t {
@@ -129,6 +561,240 @@ AGPU_TBL order_t {
    EOSLIB_SERIALIZE(order_t, (order_id)(node_id)(user)(inviter)(price)(create_time))
 };
 
+/// compact order table, v2 encoding of order_t written by new orders
+// scope: user account, which is also the order user
+// price symbol is always _gstate.usdt_symbol, only the amount is kept
+AGPU_TBL order_v2_t {
+   uint64_t               order_id;    // order id
+   unsigned_int           node_id;     // node id
+   name                   inviter;     // inviter account
+   int64_t                amount = 0;  // order price amount
+   time_point_sec         create_time; // create timestamp
+   binary_extension<name> ram_payer;   // user paying for the row, absent when the contract pays
+
+   order_v2_t() {}
+   order_v2_t(const uint64_t& i) : order_id(i) {}
+   order_v2_t(const order_t& o)
+       : order_id(o.order_id), node_id(o.node_id), inviter(o.inviter), amount(o.price.amount), create_time(o.create_time) {}
+
+   uint64_t primary_key() const { return order_id; }
+   uint64_t scope() const { return 0; }
+
+   order_t to_order(const name& user, const symbol& price_symbol) const {
+      order_t order(order_id);
+      order.node_id     = node_id.value;
+      order.user        = user;
+      order.inviter     = inviter;
+      order.price       = asset(amount, price_symbol);
+      order.create_time = create_time;
+      return order;
+   }
+
+   typedef multi_index<"orders2"_n, order_v2_t> tbl_t;
+
+   EOSLIB_SERIALIZE(order_v2_t, (order_id)(node_id)(inviter)(amount)(create_time)(ram_payer))
+};
+
+/// inviter sale table, orders bought by the invitees of an inviter
+// scope: node id, 0 for the sum over every node
+AGPU_TBL inviter_sale_t {
+   name           inviter;         // inviter recorded on the orders
+   uint64_t       order_count = 0; // live order count
+   asset          volume;          // sum of order prices
+   time_point_sec update_time;     // update timestamp
+
+   inviter_sale_t() {}
+   inviter_sale_t(const name& n) : inviter(n) {}
+
+   uint64_t primary_key() const { return inviter.value; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"invitersales"_n, inviter_sale_t> tbl_t;
+
+   EOSLIB_SERIALIZE(inviter_sale_t, (inviter)(order_count)(volume)(update_time))
+};
+
+/// preorder table, paid requests queued before the node start time
+// scope: node id
+// a new id follows the last one queued, so ascending primary keys are the arrival order
+AGPU_TBL preorder_t {
+   uint64_t       id;          // preorder id
+   name           user;        // user account
+   uint64_t       count = 0;   // units asked for
+   asset          quantity;    // paid quantity, count times the unit price
+   time_point_sec create_time; // create timestamp
+
+   preorder_t() {}
+   preorder_t(const uint64_t& i) : id(i) {}
+
+   uint64_t primary_key() const { return id; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"preorders"_n, preorder_t> tbl_t;
+
+   EOSLIB_SERIALIZE(preorder_t, (id)(user)(count)(quantity)(create_time))
+};
+
+/// purchase voucher, signed off-chain with config_t::voucher_key over sha256(pack(voucher_t))
+struct voucher_t {
+   checksum256 chain_id;   // chain id, keeps a voucher from being replayed on another chain
+   name        contract;   // redeeming contract account, keeps a voucher to one deployment
+   uint64_t    node_id;    // node id
+   name        user;       // user account, the only one able to redeem it
+   uint64_t    count  = 0; // units
+   uint64_t    nonce  = 0; // unique per voucher, its bit is set in voucherbits once redeemed
+   uint32_t    expiry = 0; // last second the voucher can be redeemed
+
+   EOSLIB_SERIALIZE(voucher_t, (chain_id)(contract)(node_id)(user)(count)(nonce)(expiry))
+};
+
+/// voucher bits table, redeemed nonces of one batch of VOUCHER_BATCH_BITS
+// scope: contract account
+AGPU_TBL voucher_bits_t {
+   uint64_t         batch; // nonce / VOUCHER_BATCH_BITS
+   vector<uint64_t> bits;  // bit nonce % VOUCHER_BATCH_BITS is set once redeemed
+
+   voucher_bits_t() {}
+   voucher_bits_t(const uint64_t& i) : batch(i) {}
+
+   uint64_t primary_key() const { return batch; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"voucherbits"_n, voucher_bits_t> tbl_t;
+
+   EOSLIB_SERIALIZE(voucher_bits_t, (batch)(bits))
+};
+
+/// orderlog payload
+// version 2 made holding optional and added leaf_index, version 1 carried the leaf index in holding
+struct order_log_t {
+   order_t            order;       // order row, erased rows are logged as they were
+   optional<uint64_t> total_saled; // node total_saled after the event, when it changed
+   optional<uint64_t> holding;     // user total of the node after the event, when it changed
+   optional<uint64_t> leaf_index;  // accumulator leaf index of the order, ARCHIVE only
+
+   EOSLIB_SERIALIZE(order_log_t, (order)(total_saled)(holding)(leaf_index))
+};
+
+/// order accumulator table, archived orders of a node folded into a merkle mountain range
+// scope: contract account
+// leaf i is sha256(pack(order_t)) of the i-th archived order of the node
+AGPU_TBL order_acc_t {
+   uint64_t            node_id;        // node id
+   uint64_t            leaf_count = 0; // archived order count
+   vector<checksum256> peaks;          // peaks of the perfect trees, tallest first
+   checksum256         root;           // bagged peaks
+   time_point_sec      update_time;    // update timestamp
+
+   order_acc_t() {}
+   order_acc_t(const uint64_t& i) : node_id(i) {}
+
+   uint64_t primary_key() const { return node_id; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"orderaccs"_n, order_acc_t> tbl_t;
+
+   EOSLIB_SERIALIZE(order_acc_t, (node_id)(leaf_count)(peaks)(root)(update_time))
+};
+
+/// hourly stat table, events counted in the hour they happened
+// scope: node id, 0 for every node together with the signups
+AGPU_TBL hour_stat_t {
+   time_point_sec start;       // hour start timestamp
+   uint64_t       orders  = 0; // orders bought
+   uint64_t       deleted = 0; // orders deleted
+   uint64_t       signups = 0; // users signed up, scope 0 only
+
+   hour_stat_t() {}
+   hour_stat_t(const time_point_sec& t) : start(t) {}
+
+   uint64_t primary_key() const { return start.sec_since_epoch(); }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"hourstats"_n, hour_stat_t> tbl_t;
+
+   EOSLIB_SERIALIZE(hour_stat_t, (start)(orders)(deleted)(signups))
+};
+
+/// daily stat table, hourly stats rolled up by rollstats
+// scope: node id, 0 for every node together with the signups
+// a day is only rolled up as a whole, so every event is in exactly one hourly or daily row
+AGPU_TBL day_stat_t {
+   time_point_sec start;       // day start timestamp
+   uint64_t       orders  = 0; // orders bought
+   uint64_t       deleted = 0; // orders deleted
+   uint64_t       signups = 0; // users signed up, scope 0 only
+
+   day_stat_t() {}
+   day_stat_t(const time_point_sec& t) : start(t) {}
+
+   uint64_t primary_key() const { return start.sec_since_epoch(); }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"daystats"_n, day_stat_t> tbl_t;
+
+   EOSLIB_SERIALIZE(day_stat_t, (start)(orders)(deleted)(signups))
+};
+
+/// node gc table, dependent rows of a deleted node waiting to be erased
+// scope: contract account
+AGPU_TBL node_gc_t {
+   uint64_t       node_id;        // deleted node id
+   name           user;           // user cursor, next user to sweep
+   uint64_t       order_id   = 0; // order cursor inside the current user
+   uint64_t       orders     = 0; // erased order count
+   uint64_t       totals     = 0; // erased node total count
+   time_point_sec create_time;    // create timestamp
+   time_point_sec update_time;    // update timestamp
+
+   node_gc_t() {}
+   node_gc_t(const uint64_t& i) : node_id(i) {}
+
+   uint64_t primary_key() const { return node_id; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"nodegcs"_n, node_gc_t> tbl_t;
+
+   EOSLIB_SERIALIZE(node_gc_t, (node_id)(user)(order_id)(orders)(totals)(create_time)(update_time))
+};
+
+/// reconcile tally table, recounted value against the recorded one
+// scope: ReconScope::NODE or ReconScope::INVITER
+AGPU_TBL recon_tally_t {
+   uint64_t id;           // node id or inviter account value
+   uint64_t counted  = 0; // value recounted from source rows
+   uint64_t recorded = 0; // value found in nodes or invites
+
+   recon_tally_t() {}
+   recon_tally_t(const uint64_t& i) : id(i) {}
+
+   uint64_t primary_key() const { return id; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"recontally"_n, recon_tally_t> tbl_t;
+
+   EOSLIB_SERIALIZE(recon_tally_t, (id)(counted)(recorded))
+};
+
+/// eligible table, inviter levels read from acpuminedapp usermisite
+// scope: contract account
+// only eligible inviters are cached, a failed check reverts its own cache write
+AGPU_TBL eligible_t {
+   name           inviter;     // inviter account
+   uint16_t       level = 0;   // usermisite level when cached
+   time_point_sec expire_time; // cached level is used until this timestamp
+
+   eligible_t() {}
+   eligible_t(const name& n) : inviter(n) {}
+
+   uint64_t primary_key() const { return inviter.value; }
+   uint64_t scope() const { return 0; }
+
+   typedef multi_index<"eligibles"_n, eligible_t> tbl_t;
+
+   EOSLIB_SERIALIZE(eligible_t, (inviter)(level)(expire_time))
+};
+
 AGPU_TBL user_mining_site_t {
    name           account;                                   // 账号
    uint16_t       level          = 0;                        // 级别
@@ -157,4 +823,12 @@ AGPU_TBL user_mining_site_t {
    typedef eosio::multi_index<"usermisite"_n, user_mining_site_t> idx_t;
 };
 
+/// usermisite projection, the leading fields of user_mining_site_t
+struct user_mining_level_t {
+   name     account;   // 账号
+   uint16_t level = 0; // 级别
+
+   EOSLIB_SERIALIZE(user_mining_level_t, (account)(level))
+};
+
 } // namespace amax
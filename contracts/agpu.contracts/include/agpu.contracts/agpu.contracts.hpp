@@ -8,6 +8,9 @@
 #include <string>
 
 #include <agpu.contracts/agpu.contracts.db.hpp>
+#include <agpu.contracts/agpu.contracts.policy.hpp>
+#include <agpu.contracts/agpu.contracts.pricing.hpp>
+#include <merkle.hpp>
 #include <wasm_db.hpp>
 
 namespace amax {
@@ -18,30 +21,53 @@ using std::vector;
 using namespace eosio;
 using namespace wasm::db;
 
+/// what an order visitor of _scan_orders wants done with the visited order
+enum class visit_t : uint8_t {
+   NEXT  = 0, // keep the order and continue
+   ERASE = 1, // erase the order and continue
+   STOP  = 2, // stop before this order, it is visited again on resume
+};
+
 class [[eosio::contract("agpucontracts")]] agpu : public contract {
 
  public:
    using contract::contract;
 
    agpu(eosio::name receiver, eosio::name code, datastream<const char*> ds)
-       : contract(receiver, code, ds), _global(get_self(), get_self().value), _db(_self) {
+       : contract(receiver, code, ds), _global(get_self(), get_self().value), _config(get_self(), get_self().value), _db(_self) {
       _gstate = _global.exists() ? _global.get() : global_t{};
+      _conf   = _config.get_or_default();
    }
 
-   ~agpu() { _global.set(_gstate, get_self()); }
+   ~agpu() {
+      _db.flush();
+      _global.set(_gstate, get_self());
+   }
 
    ACTION init(const name& admin, const name& bank, const name& usdt_contract, const symbol& usdt_symbol);
 
    ACTION addnode(const asset& price, const uint64_t& max_sale, const uint32_t& start_time);
 
-   ACTION setnode(const uint64_t& node_id, const asset& price, const uint64_t& max_sale, const uint32_t& start_time);
+   ACTION setnode(const uint64_t& node_id, const asset& price, const uint64_t& max_sale, const uint32_t& start_time,
+                  const binary_extension<checksum256>& allowlist_root);
 
    ACTION delnode(const uint64_t& node_id);
 
+   ACTION setpricing(const uint64_t& node_id, const name& curve, const int64_t& base, const int64_t& step, const uint32_t& rate,
+                     const vector<price_tier_t>& tiers);
+
+   ACTION prove(const name& user, const uint64_t& node_id, const uint64_t& cap, const vector<checksum256>& proof);
+
+   ACTION gcnode(const uint64_t& node_id, const uint32_t& max_rows);
+
    ACTION settotalsale(const uint64_t& node_id, const uint64_t& total_saled);
 
    ACTION setnodestate(const uint64_t& node_id, const name& status);
 
+   ACTION recbegin(const bool& apply);
+
+   ACTION recstep(const uint32_t& max_rows);
+
    ACTION signup(const name& user, const name& inviter);
 
    ACTION signbind(const name& user, const name& inviter);
@@ -50,18 +76,125 @@ class [[eosio::contract("agpucontracts")]] agpu : public contract {
 
    ACTION signdel(const name& user);
 
+   ACTION seteligttl(const uint32_t& eligible_ttl);
+
+   ACTION clrelig(const name& inviter);
+
    ACTION addorder(const uint64_t& node_id, const name& user, const asset& quantity);
 
    ACTION delorder(const uint64_t& order_id, const name& user);
 
+   ACTION setvoucher(const public_key& voucher_key, const checksum256& voucher_chain);
+
+   ACTION redeem(const voucher_t& voucher, const signature& sig);
+
+   ACTION allocate(const uint64_t& node_id, const uint32_t& max_rows);
+
+   ACTION buy(const name& user, const uint64_t& node_id, const uint64_t& count);
+
+   ACTION withdraw(const name& user, const asset& quantity);
+
+   ACTION refund(const name& user);
+
+   ACTION setarchive(const uint32_t& archive_delay);
+
+   ACTION archive(const uint32_t& max_rows);
+
+   ACTION verifyorder(const uint64_t& index, const order_t& order, const vector<checksum256>& proof);
+
+   ACTION setteamdepth(const uint8_t& team_depth);
+
+   ACTION setretention(const uint32_t& stat_retention);
+
+   ACTION rollstats(const uint64_t& node_id, const uint32_t& max_rows);
+
+   ACTION setsweep(const uint32_t& sweep_interval, const int64_t& sweep_threshold);
+
+   ACTION sweep();
+
+   ACTION setcommrate(const uint64_t& node_id, const vector<uint16_t>& rates);
+
+   ACTION claim(const name& inviter);
+
+   ACTION setshards(const vector<name>& shards);
+
+   ACTION setcoord(const name& coordinator);
+
+   ACTION grant(const uint64_t& node_id, const name& shard, const uint64_t& quota);
+
+   ACTION rebalance(const uint64_t& node_id, const name& from, const name& to, const uint64_t& units);
+
+   ACTION syncnode(const node_t& node);
+
+   ACTION setlog(const bool& event_log);
+
+   ACTION useportfolio();
+
+   ACTION setrampayer(const name& ram_payer);
+
+   ACTION nodelog(const uint8_t& version, const name& event, const node_t& node);
+
+   ACTION invitelog(const uint8_t& version, const name& event, const invite_t& invite);
+
+   ACTION orderlog(const uint8_t& version, const name& event, const order_log_t& log);
+
+   using nodelog_action   = eosio::action_wrapper<"nodelog"_n, &agpu::nodelog>;
+   using invitelog_action = eosio::action_wrapper<"invitelog"_n, &agpu::invitelog>;
+   using orderlog_action  = eosio::action_wrapper<"orderlog"_n, &agpu::orderlog>;
+   using syncnode_action  = eosio::action_wrapper<"syncnode"_n, &agpu::syncnode>;
+
    [[eosio::on_notify("*::transfer")]] void on_transfer(const name& from, const name& to, const asset& quantity, const string& memo);
 
  private:
    global_singleton _global;
    global_t         _gstate;
+   config_singleton _config;
+   config_t         _conf;
    dbc              _db;
 
-   void _buy(const uint64_t& node_id, const name& user, const asset& quantity);
+   optional<shard_conf_t> _shard; // read on first use by _shard_conf
+
+   order_t _buy(const node_t& node, const name& user, const asset& quantity, const name& event);
+   void _signup(const name& user, const name& inviter);
+   void _check_inviter(const name& inviter);
+   const shard_conf_t& _shard_conf();
+   void _check_not_shard();
+   bool _is_local(const name& user);
+   void _check_remote_inviter(const name& inviter);
+   void _sync_quota(const node_t& node, const name& shard, const uint64_t& quota);
+   asset _quote(const node_t& node, const uint64_t& count);
+   void _check_allowlist(const uint64_t& node_id, const name& user, const uint64_t& count);
+   void _release_allowlist(const uint64_t& node_id, const name& user, const uint64_t& count);
+   bool _del_order(const name& user, const uint64_t& order_id, order_t& order);
+   bool _has_rows(const name& user);
+   uint64_t _add_node_total(const name& user, const uint64_t& node_id, const int64_t& count);
+   bool _del_node_total(const name& user, const uint64_t& node_id);
+   name _ram_payer(const name& user);
+   void _account_ram(const name& payer, const int64_t& rows, const int64_t& bytes);
+   uint64_t _add_portfolio(const name& user, const uint64_t& node_id, const int64_t& count);
+   bool _del_portfolio(const name& user, const uint64_t& node_id);
+   void _log_node(const name& event, const node_t& node);
+   void _log_invite(const name& event, const invite_t& invite);
+   void _log_order(const name& event, const order_t& order, const optional<uint64_t>& total_saled, const optional<uint64_t>& holding,
+                   const optional<uint64_t>& leaf_index);
+   template <typename Visitor>
+   uint64_t _scan_orders(const name& user, const uint64_t& from_order_id, Visitor&& visit);
+   void _settle(const name& token_contract, const asset& quantity, const string& memo);
+   checksum256 _order_leaf(const order_t& order);
+   void _add_subtree(const name& user, const int64_t& sign);
+   void _add_team_orders(const name& user, const int64_t& count);
+   void _add_inviter_sale(const order_t& order, const int64_t& sign);
+   void _rank_inviter(const invite_t& invite);
+   void _add_balance(const name& user, const asset& quantity);
+   asset _add_commission(const order_t& order);
+   void _add_stat(const uint64_t& node_id, const uint64_t& orders, const uint64_t& deleted, const uint64_t& signups);
+
+   void _recon_clear(reconcile_t& state, uint32_t& rows, const uint32_t& max_rows);
+   void _recon_count(reconcile_t& state, uint32_t& rows, const uint32_t& max_rows);
+   void _recon_nodes(reconcile_t& state, uint32_t& rows, const uint32_t& max_rows);
+   void _recon_invites(reconcile_t& state, uint32_t& rows, const uint32_t& max_rows);
+   void _recon_tally(const name& scope, const uint64_t& id, const uint64_t& count);
+   void _check_reconcile();
 };
 
 } // namespace amax
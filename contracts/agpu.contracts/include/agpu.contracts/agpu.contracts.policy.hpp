@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+namespace amax {
+
+/// referral validation applied to an inviter on signup and signedit
+enum class referral_t : uint8_t {
+   NONE        = 0, // any signed up inviter is accepted
+   MINING_SITE = 1, // inviter must own a usermisite row on acpuminedapp with level > 0
+};
+
+/// what happens to the payment of a buy
+enum class settlement_t : uint8_t {
+   HOLD    = 0, // payment stays in the contract account
+   FORWARD = 1, // payment is transferred to the bank inline
+};
+
+/// counters maintained on signup, signbind and signedit
+enum class counter_t : uint8_t {
+   NONE   = 0, // inviter rows are only checked, never written
+   INVITE = 1, // inviter invite_count is kept up to date
+};
+
+/// build time feature selection of the agpu contract, disabled features are
+/// discarded through `if constexpr` and cost neither code size nor host calls
+template <referral_t Referral, settlement_t Settlement, counter_t Counter>
+struct agpu_policy {
+   static constexpr referral_t   referral   = Referral;
+   static constexpr settlement_t settlement = Settlement;
+   static constexpr counter_t    counter    = Counter;
+};
+
+using full_policy = agpu_policy<referral_t::MINING_SITE, settlement_t::FORWARD, counter_t::INVITE>;
+using open_policy = agpu_policy<referral_t::NONE, settlement_t::FORWARD, counter_t::INVITE>;
+using lite_policy = agpu_policy<referral_t::NONE, settlement_t::HOLD, counter_t::NONE>;
+
+// selected per CMake target, see contracts/agpu.contracts/CMakeLists.txt
+#ifndef AGPU_POLICY
+#define AGPU_POLICY full_policy
+#endif
+
+using policy = AGPU_POLICY;
+
+} // namespace amax
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <agpu.contracts/agpu.contracts.db.hpp>
+
+namespace amax {
+
+// fixed point scale of the exponential growth factor, a multiple of RATIO_BOOST
+static constexpr int128_t PRICE_SCALE = 1000000000000LL;
+static constexpr int128_t PRICE_MAX   = int128_t(~uint128_t(0) >> 1);
+
+/// a * b, checked against int128 overflow
+inline int128_t price_mul(const int128_t& a, const int128_t& b) {
+   CHECK(a >= 0 && b >= 0, "negative price operand");
+   CHECK(b == 0 || a <= PRICE_MAX / b, "price overflow");
+   return a * b;
+}
+
+/// total + term, checked to stay an int64 amount
+inline int128_t price_add(const int128_t& total, const int128_t& term) {
+   CHECK(term <= numeric_limits<int64_t>::max() && total + term <= numeric_limits<int64_t>::max(), "price overflow");
+   return total + term;
+}
+
+/// PRICE_SCALE * (1 + rate / RATIO_BOOST) ^ n by squaring, O(log n)
+inline int128_t price_growth(const uint32_t& rate, uint64_t n) {
+   int128_t result = PRICE_SCALE;
+   int128_t factor = PRICE_SCALE / RATIO_BOOST * (RATIO_BOOST + rate);
+   for (; n > 0; n >>= 1) {
+      if (n & 1)
+         result = price_mul(result, factor) / PRICE_SCALE;
+      if (n > 1)
+         factor = price_mul(factor, factor) / PRICE_SCALE;
+   }
+   return result;
+}
+
+/**
+ * cost of the first n units of a priced node in closed form, without a loop over units:
+ * k units bought at total_saled s cost price_total(s + k) - price_total(s)
+ */
+inline int64_t price_total(const pricing_t& pricing, const uint64_t& n) {
+   int128_t total = 0;
+
+   if (pricing.curve == PriceCurve::TIERS) {
+      for (size_t i = 0; i < pricing.tiers.size() && pricing.tiers[i].from_saled < n; i++) {
+         const uint64_t end = i + 1 < pricing.tiers.size() ? min(n, pricing.tiers[i + 1].from_saled) : n;
+         total = price_add(total, price_mul(pricing.tiers[i].amount, end - pricing.tiers[i].from_saled));
+      }
+   } else if (pricing.curve == PriceCurve::LINEAR) {
+      // n * base + step * n * (n - 1) / 2
+      const int128_t pairs = n == 0 ? 0 : price_mul(n, n - 1) / 2;
+      total = price_add(price_add(0, price_mul(n, pricing.base)), price_mul(pricing.step, pairs));
+   } else if (pricing.curve == PriceCurve::EXPONENTIAL) {
+      // base * (g ^ n - 1) / (g - 1), with g - 1 = rate / RATIO_BOOST
+      const int128_t units = price_mul(price_growth(pricing.rate, n) - PRICE_SCALE, RATIO_BOOST) / pricing.rate;
+      total = price_add(0, price_mul(pricing.base, units) / PRICE_SCALE);
+   } else {
+      CHECK(false, "invalid price curve: " + pricing.curve.to_string());
+   }
+   return int64_t(total);
+}
+
+} // namespace amax
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <eosio/crypto.hpp>
+#include <eosio/eosio.hpp>
+
+#include <array>
+#include <vector>
+
+namespace wasm { namespace merkle {
+
+using namespace eosio;
+using std::vector;
+
+/// sha256 of left || right
+inline checksum256 hash_pair(const checksum256& left, const checksum256& right) {
+    std::array<uint8_t, 64> data;
+    auto l = left.extract_as_byte_array();
+    auto r = right.extract_as_byte_array();
+    std::copy(l.begin(), l.end(), data.begin());
+    std::copy(r.begin(), r.end(), data.begin() + 32);
+    return sha256((const char*)data.data(), data.size());
+}
+
+/**
+ * append-only accumulator kept as the peaks of perfect trees (merkle mountain range):
+ * one peak per set bit of leaf_count, tallest first, so storage stays O(log n)
+ */
+inline void append(vector<checksum256>& peaks, const uint64_t& leaf_count, const checksum256& leaf) {
+    checksum256 hash = leaf;
+    for (uint64_t n = leaf_count; n & 1; n >>= 1) {
+        hash = hash_pair(peaks.back(), hash);
+        peaks.pop_back();
+    }
+    peaks.push_back(hash);
+}
+
+/// single root committing to every peak, folded from the shortest peak up
+inline checksum256 bag(const vector<checksum256>& peaks) {
+    if (peaks.empty()) return checksum256();
+
+    checksum256 root = peaks.back();
+    for (auto itr = peaks.rbegin() + 1; itr != peaks.rend(); itr++) {
+        root = hash_pair(*itr, root);
+    }
+    return root;
+}
+
+/**
+ * check that leaf is the index-th appended leaf: proof lists the siblings from
+ * the leaf up to the peak of its perfect tree, lowest first
+ */
+inline bool verify(const vector<checksum256>& peaks, const uint64_t& leaf_count, const uint64_t& index,
+                   const checksum256& leaf, const vector<checksum256>& proof) {
+    if (index >= leaf_count) return false;
+
+    uint64_t offset = 0;
+    size_t   peak   = 0;
+    int      height = 63;
+    for (; height >= 0; height--) {
+        const uint64_t size = uint64_t(1) << height;
+        if (!(leaf_count & size)) continue;
+        if (index < offset + size) break;
+        offset += size;
+        peak++;
+    }
+    if (peak >= peaks.size() || proof.size() != size_t(height)) return false;
+
+    const uint64_t local = index - offset;
+    checksum256    hash  = leaf;
+    for (size_t i = 0; i < proof.size(); i++) {
+        hash = (local >> i) & 1 ? hash_pair(proof[i], hash) : hash_pair(hash, proof[i]);
+    }
+    return hash == peaks[peak];
+}
+
+/**
+ * check a proof of a tree hashed with sorted pairs, where every parent is
+ * hash_pair(min(a, b), max(a, b)) so a proof needs no leaf position
+ */
+inline bool verify_sorted(const checksum256& root, const checksum256& leaf, const vector<checksum256>& proof) {
+    checksum256 hash = leaf;
+    for (const auto& sibling : proof) {
+        hash = sibling < hash ? hash_pair(sibling, hash) : hash_pair(hash, sibling);
+    }
+    return hash == root;
+}
+
+} } //merkle//wasm
@@ -3,6 +3,9 @@
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
 
+#include <memory>
+#include <vector>
+
 namespace wasm { namespace db {
 
 using namespace eosio;
@@ -34,41 +37,334 @@ public:
     }
 };
 
+/**
+ * placeholder of N packed bytes in a projection layout, the bytes are
+ * skipped on decode
+ */
+template<size_t N>
+struct skip_t {
+    template<typename DataStream>
+    friend DataStream& operator<<( DataStream& ds, const skip_t& ) {
+        ds.skip(N);
+        return ds;
+    }
+
+    template<typename DataStream>
+    friend DataStream& operator>>( DataStream& ds, skip_t& ) {
+        ds.skip(N);
+        return ds;
+    }
+};
+
+static constexpr size_t max_projection_size = 256;
+
+/**
+ * read a projection of a row: only the leading bytes it covers are copied
+ * out of the db and decoded, the rest of the row is never touched.
+ * Projection declares a prefix of the stored layout with EOSLIB_SERIALIZE,
+ * leading fields it does not need are declared as skip_t<packed size>,
+ * so every field of a projection must have a fixed packed size.
+ */
+template<typename Projection>
+bool get_projection(const name& code, const uint64_t& scope, const name& table, const uint64_t& pk, Projection& projection) {
+    auto itr = internal_use_do_not_use::db_find_i64(code.value, scope, table.value, pk);
+    if (itr < 0) return false;
+
+    const size_t size = pack_size(projection);
+    check( size <= max_projection_size, "projection too large" );
+
+    char buffer[max_projection_size];
+    auto copied = internal_use_do_not_use::db_get_i64(itr, buffer, size);
+    check( size_t(copied) == size, "projection exceeds row size" );
+
+    datastream<const char*> ds(buffer, size);
+    ds >> projection;
+    return true;
+}
+
 enum return_t{
     NONE    = 0,
     MODIFIED,
     APPENDED,
 };
 
+/**
+ * per-action identity map of one (table, scope): rows are decoded once,
+ * later reads and writes go to the cached copy and every dirty row is
+ * written back once by flush()
+ */
+struct table_cache_base {
+    name     table;
+    uint64_t scope;
+
+    table_cache_base(const name& table, const uint64_t& scope): table(table), scope(scope) {}
+    virtual ~table_cache_base() {}
+
+    virtual void flush() = 0;
+};
+
+template<typename RecordType>
+struct table_cache: public table_cache_base {
+    struct row_t {
+        uint64_t   pk;
+        RecordType record;
+        bool       stored  = false; // row exists in the chain db
+        bool       present = false; // row exists after the pending writes
+        bool       dirty   = false;
+        name       payer;
+    };
+
+    typename RecordType::tbl_t idx;
+    std::vector<row_t>         rows;
+
+    table_cache(const name& code, const uint64_t& scope)
+        : table_cache_base(RecordType::tbl_t::table_name(), scope), idx(code, scope) {}
+
+    row_t* find(const uint64_t& pk) {
+        for (auto& row : rows) {
+            if (row.pk == pk) return &row;
+        }
+        return nullptr;
+    }
+
+    row_t& load(const uint64_t& pk) {
+        if (auto row = find(pk)) return *row;
+
+        row_t row;
+        row.pk  = pk;
+        auto itr = idx.find(pk);
+        if (itr != idx.end()) {
+            row.record  = *itr;
+            row.stored  = true;
+            row.present = true;
+        }
+        rows.push_back(row);
+        return rows.back();
+    }
+
+    void flush(row_t& row) {
+        if (!row.dirty) return;
+
+        // a stored row is found in the item cache of the table instance without a db call,
+        // a row missing when it was loaded is emplaced without looking it up again
+        auto itr = row.stored ? idx.find(row.pk) : idx.end();
+        if (!row.present) {
+            if (itr != idx.end()) idx.erase(itr);
+        } else if (itr != idx.end()) {
+            idx.modify( itr, same_payer, [&]( auto& item ) {
+                item = row.record;
+            });
+        } else {
+            idx.emplace( row.payer, [&]( auto& item ) {
+                item = row.record;
+            });
+        }
+        row.stored = row.present;
+        row.dirty  = false;
+    }
+
+    void flush() override {
+        for (auto& row : rows) {
+            flush(row);
+        }
+    }
+
+    /// write back and forget the cached copy of pk, the table instance becomes its only owner
+    void evict(const uint64_t& pk) {
+        for (auto itr = rows.begin(); itr != rows.end(); itr++) {
+            if (itr->pk != pk) continue;
+
+            flush(*itr);
+            rows.erase(itr);
+            return;
+        }
+    }
+};
+
+/**
+ * row handle returned by dbc::find, it keeps the table instance and the
+ * iterator so that a later modify or erase does not look the row up again
+ */
+template<typename RecordType>
+struct handle_t {
+    using tbl_t = typename RecordType::tbl_t;
+
+    std::unique_ptr<tbl_t>         owned;           // table instance when dbc is not cached
+    tbl_t*                         idx = nullptr;
+    typename tbl_t::const_iterator itr;
+
+    explicit operator bool() const { return itr != idx->end(); }
+    const RecordType& operator*() const { return *itr; }
+    const RecordType* operator->() const { return &*itr; }
+};
+
 class dbc {
 private:
     name code;   //contract owner
+    bool cached = false;
+    std::vector<std::unique_ptr<table_cache_base>> tables;
+
+    template<typename RecordType>
+    table_cache<RecordType>* find_cache(const uint64_t& scope) {
+        const name table = RecordType::tbl_t::table_name();
+        for (auto& tbl : tables) {
+            if (tbl->table == table && tbl->scope == scope)
+                return static_cast<table_cache<RecordType>*>(tbl.get());
+        }
+        return nullptr;
+    }
+
+    template<typename RecordType>
+    table_cache<RecordType>& cache_of(const uint64_t& scope) {
+        if (auto tbl = find_cache<RecordType>(scope)) return *tbl;
+
+        tables.push_back(std::make_unique<table_cache<RecordType>>(code, scope));
+        return static_cast<table_cache<RecordType>&>(*tables.back());
+    }
+
+    template<typename RecordType>
+    return_t cache_set(const uint64_t& scope, const RecordType& record, const name& payer) {
+        auto& row = cache_of<RecordType>(scope).load(record.primary_key());
+        return_t ret = row.present ? return_t::MODIFIED : return_t::APPENDED;
+        row.record  = record;
+        row.present = true;
+        row.dirty   = true;
+        if (!row.stored) row.payer = payer;
+        return ret;
+    }
 
 public:
     dbc() {}
     dbc(const name& code): code(code) {}
 
+    /// route get/set/del of this action through the identity map,
+    /// the owner must call flush() before the action returns
+    void enable_cache() { cached = true; }
+
+    /// write every dirty cached row back to the chain db
+    void flush() {
+        for (auto& tbl : tables) {
+            tbl->flush();
+        }
+    }
+
     template<typename RecordType>
     bool get(RecordType& record) {
         auto scope = code.value;
+        if (cached) return get(scope, record);
 
         typename RecordType::tbl_t idx(code, scope);
-        if (idx.find(record.primary_key()) == idx.end())
+        auto itr = idx.find(record.primary_key());
+        if (itr == idx.end())
             return false;
 
-        record = idx.get(record.primary_key());
+        record = *itr;
         return true;
     }
     template<typename RecordType>
     bool get(const uint64_t& scope, RecordType& record) {
+        if (cached) {
+            auto& row = cache_of<RecordType>(scope).load(record.primary_key());
+            if (!row.present) return false;
+
+            record = row.record;
+            return true;
+        }
+
         typename RecordType::tbl_t idx(code, scope);
-        if (idx.find(record.primary_key()) == idx.end())
+        auto itr = idx.find(record.primary_key());
+        if (itr == idx.end())
             return false;
 
-        record = idx.get(record.primary_key());
+        record = *itr;
         return true;
     }
 
+    /// projection read of a RecordType row, see wasm::db::get_projection;
+    /// a row held by the identity map is projected from its cached copy
+    template<typename RecordType, typename Projection>
+    bool get_projection(const uint64_t& scope, const uint64_t& pk, Projection& projection) {
+        if (cached) {
+            auto tbl = find_cache<RecordType>(scope);
+            auto row = tbl ? tbl->find(pk) : nullptr;
+            if (row) {
+                if (!row->present) return false;
+
+                auto data = pack(row->record);
+                datastream<const char*> ds(data.data(), data.size());
+                ds >> projection;
+                return true;
+            }
+        }
+
+        return wasm::db::get_projection(code, scope, RecordType::tbl_t::table_name(), pk, projection);
+    }
+
+    template<typename RecordType>
+    handle_t<RecordType> find(const uint64_t& scope, const uint64_t& pk) {
+        handle_t<RecordType> handle;
+        if (cached) {
+            auto& tbl = cache_of<RecordType>(scope);
+            tbl.evict(pk);
+            handle.idx = &tbl.idx;
+        } else {
+            handle.owned = std::make_unique<typename RecordType::tbl_t>(code, scope);
+            handle.idx   = handle.owned.get();
+        }
+        handle.itr = handle.idx->find(pk);
+        return handle;
+    }
+
+    template<typename RecordType>
+    handle_t<RecordType> find(const uint64_t& pk) {
+        return find<RecordType>(code.value, pk);
+    }
+
+    /// update fields of a found row in place, nothing else of the record is copied
+    template<typename RecordType, typename Lambda>
+    void modify(handle_t<RecordType>& handle, Lambda&& updater) {
+        check( bool(handle), "record not found" );
+        handle.idx->modify( handle.itr, same_payer, std::forward<Lambda>(updater) );
+    }
+
+    /// update a found row in place and bill it to payer, the previous payer is refunded
+    template<typename RecordType, typename Lambda>
+    void modify(handle_t<RecordType>& handle, const name& payer, Lambda&& updater) {
+        check( bool(handle), "record not found" );
+        handle.idx->modify( handle.itr, payer, std::forward<Lambda>(updater) );
+    }
+
+    template<typename RecordType>
+    void erase(handle_t<RecordType>& handle) {
+        check( bool(handle), "record not found" );
+        handle.itr = handle.idx->erase( handle.itr );
+    }
+
+    /// insert-only path for rows whose primary key can not exist yet, e.g. monotonic ids
+    template<typename RecordType>
+    void insert(const uint64_t& scope, const RecordType& record, const name& payer) {
+        auto emplace = [&]( typename RecordType::tbl_t& idx ) {
+            idx.emplace( payer, [&]( auto& item ) {
+                item = record;
+            });
+        };
+
+        if (cached) {
+            auto& tbl = cache_of<RecordType>(scope);
+            tbl.evict(record.primary_key());
+            emplace(tbl.idx);
+            return;
+        }
+
+        typename RecordType::tbl_t idx(code, scope);
+        emplace(idx);
+    }
+
+    template<typename RecordType>
+    void insert(const uint64_t& scope, const RecordType& record) {
+        insert(scope, record, code);
+    }
+
     template<typename RecordType>
     auto get_idx(RecordType& record) {
         auto scope = record.scope();
@@ -81,6 +377,7 @@ public:
     template<typename RecordType>
     return_t set(const RecordType& record, const name& payer) {
         auto scope = code.value;
+        if (cached) return cache_set(scope, record, payer);
 
         typename RecordType::tbl_t idx(code, scope);
         auto itr = idx.find( record.primary_key() );
@@ -105,6 +402,12 @@ public:
 
     template<typename RecordType>
     return_t set(const uint64_t& scope, const RecordType& record, const bool& isModify = true) {
+        if (cached) {
+            auto& row = cache_of<RecordType>(scope).load(record.primary_key());
+            check( row.present == isModify, isModify ? "record not found" : "record found" );
+            return cache_set(scope, record, code);
+        }
+
         typename RecordType::tbl_t idx(code, scope);
 
         if (isModify) {
@@ -125,6 +428,7 @@ public:
     template<typename RecordType>
     void del(const RecordType& record) {
         auto scope = code.value;
+        if (cached) return del(scope, record);
 
         typename RecordType::tbl_t idx(code, scope);
         auto itr = idx.find(record.primary_key());
@@ -135,6 +439,13 @@ public:
 
     template<typename RecordType>
     void del(const uint64_t& scope, const RecordType& record) {
+        if (cached) {
+            auto& row = cache_of<RecordType>(scope).load(record.primary_key());
+            row.present = false;
+            row.dirty   = true;
+            return;
+        }
+
         typename RecordType::tbl_t idx(code, scope);
         auto itr = idx.find(record.primary_key());
         if ( itr != idx.end() ) {
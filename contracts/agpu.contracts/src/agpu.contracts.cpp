@@ -11,6 +11,39 @@ using namespace std;
    { if (!(exp)) eosio::check(false, string("[[") + to_string((int)code) + string("]] ") + msg); }
 // clang-format on
 
+/// @brief add a signed delta to a counter, removing what was never counted stops at zero
+static void add_clamped(uint64_t& value, const int64_t& delta) {
+   value = delta >= 0 ? value + uint64_t(delta) : value - min(value, uint64_t(-delta));
+}
+
+/// @brief visit orders of a user by ascending order id, legacy rows first then compact ones
+/// compact orders are written after every legacy order, so ids keep ascending across both tables
+/// @param user - user account name
+/// @param from_order_id - first order id to visit
+/// @param visit - visitor of the decoded order, returns a visit_t
+/// @return order id to resume from when the visitor stopped, 0 when every order was visited
+template <typename Visitor>
+uint64_t agpu::_scan_orders(const name& user, const uint64_t& from_order_id, Visitor&& visit) {
+   order_t::tbl_t legacy_orders(_self, user.value);
+   for (auto itr = legacy_orders.lower_bound(from_order_id); itr != legacy_orders.end();) {
+      visit_t ret = visit(*itr);
+      if (ret == visit_t::STOP)
+         return itr->order_id;
+      itr = ret == visit_t::ERASE ? legacy_orders.erase(itr) : ++itr;
+   }
+
+   order_v2_t::tbl_t orders(_self, user.value);
+   for (auto itr = orders.lower_bound(from_order_id); itr != orders.end();) {
+      visit_t ret = visit(itr->to_order(user, _gstate.usdt_symbol));
+      if (ret == visit_t::STOP)
+         return itr->order_id;
+      if (ret == visit_t::ERASE)
+         _account_ram(itr->ram_payer.value_or(_self), -1, -int64_t(pack_size(*itr)));
+      itr = ret == visit_t::ERASE ? orders.erase(itr) : ++itr;
+   }
+   return 0;
+}
+
 /// @brief contract account initializes the project configuration
 /// @param admin - admin account name
 /// @param bank - bank account name
@@ -38,12 +71,12 @@ void agpu::addnode(const asset& price, const uint64_t& max_sale, const uint32_t&
 
    CHECKC(price.is_valid() && price.amount > 0, err::PARAM_ERROR, "invalid price");
    CHECKC(max_sale > 0, err::PARAM_ERROR, "invalid max_sale" + to_string(max_sale));
+   _check_not_shard();
    CHECKC(start_time >= current_time_point().sec_since_epoch(), err::PARAM_ERROR, "start_time must be in the future");
 
    uint64_t node_id = ++_gstate.node_id;
-   node_t   node(node_id);
-   CHECKC(!_db.get(node), err::RECORD_FOUND, "node found: " + to_string(node_id));
-
+   CHECKC(node_id <= numeric_limits<uint32_t>::max(), err::OVERSIZED, "node id exceeded: " + to_string(node_id));
+   node_t node(node_id);
    node.price       = price;
    node.max_sale    = max_sale;
    node.total_saled = 0;
@@ -51,43 +84,254 @@ void agpu::addnode(const asset& price, const uint64_t& max_sale, const uint32_t&
    node.start_time  = time_point_sec(start_time);
    node.create_time = current_time_point();
    node.update_time = current_time_point();
-   _db.set(node);
+   _db.insert(_self.value, node);
+
+   _log_node(EventType::ADDNODE, node);
 }
 
 /// @brief set node action only for admin
 /// @param node_id - node id
 /// @param price - node price
 /// @param max_sale - max sale count
-void agpu::setnode(const uint64_t& node_id, const asset& price, const uint64_t& max_sale, const uint32_t& start_time) {
+/// @param allowlist_root - optional, merkle root of the accounts allowed to buy, an empty checksum opens the node to everyone
+void agpu::setnode(const uint64_t& node_id, const asset& price, const uint64_t& max_sale, const uint32_t& start_time,
+                   const binary_extension<checksum256>& allowlist_root) {
    require_auth(_gstate.admin);
 
    CHECKC(node_id > 0, err::PARAM_ERROR, "invalid node_id" + to_string(node_id));
    CHECKC(price.is_valid() && price.amount > 0, err::PARAM_ERROR, "invalid price");
    CHECKC(max_sale > 0, err::PARAM_ERROR, "invalid max_sale" + to_string(max_sale));
+   _check_not_shard();
    CHECKC(start_time >= current_time_point().sec_since_epoch(), err::PARAM_ERROR, "start_time must be in the future");
 
-   node_t node(node_id);
-   CHECKC(_db.get(node), err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id));
+   auto node = _db.find<node_t>(node_id);
+   CHECKC(node, err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id));
+
+   // shards sell their quotas on their own, max_sale can not drop below the sum granted to them
+   uint64_t             granted = 0;
+   shard_quota_t::tbl_t quotas(_self, node_id);
+   for (auto itr = quotas.begin(); itr != quotas.end(); itr++)
+      granted += itr->quota;
+   CHECKC(max_sale >= granted, err::OVERSIZED, "max_sale below granted quotas: " + to_string(granted));
+
+   // a raised max_sale must stay quotable by the price curve of the node
+   pricing_t pricing(node_id);
+   if (max_sale > node->max_sale && _db.get(pricing))
+      price_total(pricing, max_sale);
+
+   _db.modify(node, [&](auto& row) {
+      row.price       = price;
+      row.max_sale    = max_sale;
+      row.start_time  = time_point_sec(start_time);
+      row.update_time = current_time_point();
+   });
+
+   if (allowlist_root.has_value()) {
+      allowlist_t allowlist(node_id);
+      if (allowlist_root.value() == checksum256()) {
+         _db.del(allowlist);
+      } else {
+         allowlist.root        = allowlist_root.value();
+         allowlist.update_time = current_time_point();
+         _db.set(allowlist);
+      }
+   }
 
-   node.price       = price;
-   node.max_sale    = max_sale;
-   node.start_time  = time_point_sec(start_time);
-   node.update_time = current_time_point();
-   _db.set(node);
+   _log_node(EventType::SETNODE, *node);
+}
+
+/// @brief set the price curve of a node, only for admin
+/// the whole curve up to max_sale is quoted once here and again by setnode when it raises max_sale,
+/// so no buy can overflow later
+/// @param node_id - node id
+/// @param curve - PriceCurve, FIXED removes the curve and node_t::price applies again
+/// @param base - first unit price amount, linear and exponential
+/// @param step - amount added per unit sold, linear
+/// @param rate - growth per unit sold in RATIO_BOOST, exponential
+/// @param tiers - ascending tiers starting at 0, tiers
+void agpu::setpricing(const uint64_t& node_id, const name& curve, const int64_t& base, const int64_t& step, const uint32_t& rate,
+                      const vector<price_tier_t>& tiers) {
+   require_auth(_gstate.admin);
+
+   auto node = _db.find<node_t>(node_id);
+   CHECKC(node, err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id));
+
+   preorder_t::tbl_t preorders(_self, node_id);
+   CHECKC(preorders.begin() == preorders.end(), err::STATE_MISMATCH, "node preorders pending: " + to_string(node_id));
+
+   // shards price by node_t::price, see grant
+   _check_not_shard();
+   shard_quota_t::tbl_t quotas(_self, node_id);
+   CHECKC(quotas.begin() == quotas.end(), err::STATE_MISMATCH, "node granted to shards: " + to_string(node_id));
+
+   pricing_t pricing(node_id);
+   if (curve == PriceCurve::FIXED) {
+      CHECKC(_db.get(pricing), err::RECORD_NOT_FOUND, "node pricing not found: " + to_string(node_id));
+      _db.del(pricing);
+      _log_node(EventType::SETPRICING, *node);
+      return;
+   }
+
+   if (curve == PriceCurve::TIERS) {
+      CHECKC(!tiers.empty() && tiers.size() <= MAX_PRICE_TIERS, err::OVERSIZED, "invalid tier count" + to_string(tiers.size()));
+      CHECKC(tiers[0].from_saled == 0, err::PARAM_ERROR, "first tier must start at 0");
+      for (size_t i = 0; i < tiers.size(); i++) {
+         CHECKC(tiers[i].amount > 0, err::NOT_POSITIVE, "invalid tier amount" + to_string(tiers[i].amount));
+         CHECKC(i == 0 || tiers[i].from_saled > tiers[i - 1].from_saled, err::PARAM_ERROR, "tiers must ascend");
+      }
+   } else if (curve == PriceCurve::LINEAR) {
+      CHECKC(base > 0 && step >= 0, err::PARAM_ERROR, "invalid linear curve");
+   } else if (curve == PriceCurve::EXPONENTIAL) {
+      CHECKC(base > 0 && rate > 0, err::PARAM_ERROR, "invalid exponential curve");
+   } else {
+      CHECKC(false, err::PARAM_ERROR, "invalid curve: " + curve.to_string());
+   }
+
+   pricing.curve = curve;
+   pricing.base  = base;
+   pricing.step  = step;
+   pricing.rate  = rate;
+   pricing.tiers = tiers;
+   price_total(pricing, node->max_sale);
+   _db.set(pricing);
+   _log_node(EventType::SETPRICING, *node);
+}
+
+/// @brief quote of the next units of a node, priced by its curve or by node_t::price
+/// @param node - node, total_saled is the index of the first quoted unit
+/// @param count - units
+asset agpu::_quote(const node_t& node, const uint64_t& count) {
+   pricing_t pricing(node.node_id);
+   if (!_db.get(pricing))
+      return node.price * count;
+
+   const int64_t amount = price_total(pricing, node.total_saled + count) - price_total(pricing, node.total_saled);
+   CHECKC(amount > 0, err::NOT_POSITIVE, "invalid quote: " + to_string(node.node_id));
+   return asset(amount, node.price.symbol);
+}
+
+/// @brief prove the allowlist entry of a user once, buys of the node are then capped by it
+/// @param user - user account name
+/// @param node_id - node id
+/// @param cap - max units of the entry
+/// @param proof - sibling hashes from the leaf up to the root
+void agpu::prove(const name& user, const uint64_t& node_id, const uint64_t& cap, const vector<checksum256>& proof) {
+   require_auth(user);
+
+   allowlist_t allowlist(node_id);
+   CHECKC(_db.get(allowlist), err::RECORD_NOT_FOUND, "node has no allowlist: " + to_string(node_id));
+
+   allowed_t allowed(user);
+   CHECKC(!_db.get(node_id, allowed), err::RECORD_FOUND, "allowlist entry already proved: " + user.to_string());
+
+   allow_entry_t entry;
+   entry.account   = user;
+   entry.cap       = cap;
+   const auto data = pack(entry);
+   CHECKC(wasm::merkle::verify_sorted(allowlist.root, sha256(data.data(), data.size()), proof), err::NO_AUTH,
+          "invalid allowlist proof: " + user.to_string());
+
+   allowed.cap    = cap;
+   allowed.bought = 0;
+   _db.insert(node_id, allowed, _ram_payer(user));
 }
 
 /// @brief delete node action only for admin
 /// @param node_id - node id
 void agpu::delnode(const uint64_t& node_id) {
    require_auth(_gstate.admin);
+   _check_not_shard();
 
    CHECKC(node_id > 0, err::PARAM_ERROR, "invalid node_id" + to_string(node_id));
 
-   node_t node(node_id);
-   CHECKC(_db.get(node), err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id));
-   CHECKC(node.status == NodeStatus::DISABLE, err::PARAM_ERROR, "node is enable: " + to_string(node_id));
+   auto node = _db.find<node_t>(node_id);
+   CHECKC(node, err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id));
+   CHECKC(node->status == NodeStatus::DISABLE, err::PARAM_ERROR, "node is enable: " + to_string(node_id));
+
+   // indexers drop the node's orders and totals with it, gcnode is not logged row by row
+   _log_node(EventType::DELNODE, *node);
+   _db.erase(node);
+
+   allowlist_t allowlist(node_id);
+   _db.del(allowlist);
+
+   pricing_t pricing(node_id);
+   _db.del(pricing);
+
+   // orders and node totals of the node are swept later by gcnode
+   node_gc_t gc(node_id);
+   gc.user        = name();
+   gc.order_id    = 0;
+   gc.orders      = 0;
+   gc.totals      = 0;
+   gc.create_time = current_time_point();
+   gc.update_time = current_time_point();
+   _db.set(gc);
+}
+
+/// @brief erase orders, node totals and allowlist entries of a deleted node in bounded steps, only for admin
+/// @param node_id - deleted node id
+/// @param max_rows - max rows to visit in this call
+void agpu::gcnode(const uint64_t& node_id, const uint32_t& max_rows) {
+   require_auth(_gstate.admin);
+
+   CHECKC(node_id > 0, err::PARAM_ERROR, "invalid node_id" + to_string(node_id));
+   CHECKC(max_rows > 0, err::PARAM_ERROR, "invalid max_rows" + to_string(max_rows));
+
+   node_gc_t gc(node_id);
+   CHECKC(_db.get(gc), err::RECORD_NOT_FOUND, "node gc not found: " + to_string(node_id));
+   _check_reconcile();
+
+   uint32_t rows = 0;
+
+   // proved allowlist entries go first, without the root dropped by delnode no new entry can be proved
+   allowed_t::tbl_t alloweds(_self, node_id);
+   for (auto itr = alloweds.begin(); itr != alloweds.end() && rows < max_rows; rows++)
+      itr = alloweds.erase(itr);
+
+   // users are enumerated through the invite table, signdel keeps the row of a user owning rows
+   invite_t::tbl_t invites(_self, _self.value);
+   auto            user_itr = invites.lower_bound(gc.user.value);
+
+   while (user_itr != invites.end() && rows < max_rows) {
+      const name user = user_itr->user;
+
+      uint64_t next_order_id = _scan_orders(user, gc.order_id, [&](const order_t& order) {
+         if (rows >= max_rows)
+            return visit_t::STOP;
+         rows++;
+         if (order.node_id != node_id)
+            return visit_t::NEXT;
+         gc.orders++;
+         _add_team_orders(user, -1);
+         _add_inviter_sale(order, -1);
+         return visit_t::ERASE;
+      });
+
+      if (next_order_id != 0) {
+         // budget exhausted inside the user, resume from this order next time
+         gc.user     = user;
+         gc.order_id = next_order_id;
+         break;
+      }
+
+      // the table of an emptied scope is released with its last row
+      if (_del_node_total(user, node_id))
+         gc.totals++;
+      rows++;
+
+      user_itr++;
+      gc.user     = user_itr == invites.end() ? name() : user_itr->user;
+      gc.order_id = 0;
+   }
+
+   if (user_itr == invites.end() && alloweds.begin() == alloweds.end()) {
+      _db.del(gc);
+      return;
+   }
 
-   _db.del(node);
+   gc.update_time = current_time_point();
+   _db.set(gc);
 }
 
 /// @brief set node total saled count only for admin
@@ -95,16 +339,21 @@ void agpu::delnode(const uint64_t& node_id) {
 /// @param total_saled - total saled count
 void agpu::settotalsale(const uint64_t& node_id, const uint64_t& total_saled) {
    require_auth(_gstate.admin);
+   _check_not_shard();
+   _check_reconcile();
 
    CHECKC(node_id > 0, err::PARAM_ERROR, "invalid node_id" + to_string(node_id));
    CHECKC(total_saled > 0, err::PARAM_ERROR, "invalid total_saled" + to_string(total_saled));
 
-   node_t node(node_id);
-   CHECKC(_db.get(node), err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id));
+   auto node = _db.find<node_t>(node_id);
+   CHECKC(node, err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id));
 
-   node.total_saled = total_saled;
-   node.update_time = current_time_point();
-   _db.set(node);
+   _db.modify(node, [&](auto& row) {
+      row.total_saled = total_saled;
+      row.update_time = current_time_point();
+   });
+
+   _log_node(EventType::SETTOTALSALE, *node);
 }
 
 /// @brief set node status only for admin
@@ -112,16 +361,355 @@ void agpu::settotalsale(const uint64_t& node_id, const uint64_t& total_saled) {
 /// @param status - node status (enable or disable)
 void agpu::setnodestate(const uint64_t& node_id, const name& status) {
    require_auth(_gstate.admin);
+   _check_not_shard();
 
    CHECKC(node_id > 0, err::PARAM_ERROR, "invalid node_id" + to_string(node_id));
    CHECKC(status == NodeStatus::ENABLE || status == NodeStatus::DISABLE, err::PARAM_ERROR, "invalid state" + status.to_string());
 
-   node_t node(node_id);
-   CHECKC(_db.get(node), err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id));
+   auto node = _db.find<node_t>(node_id);
+   CHECKC(node, err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id));
 
-   node.status      = status;
-   node.update_time = current_time_point();
-   _db.set(node);
+   _db.modify(node, [&](auto& row) {
+      row.status      = status;
+      row.update_time = current_time_point();
+   });
+
+   _log_node(EventType::SETNODESTATE, *node);
+}
+
+/// @brief start recounting node total_saled and inviter invite_count, only for admin
+/// an applying run refuses buys, signups, order deletions and settotalsale until it is done, see _check_reconcile
+/// @param apply - write the recounted values back during the compare phases
+void agpu::recbegin(const bool& apply) {
+   require_auth(_gstate.admin);
+
+   reconcile_singleton recon(_self, _self.value);
+   reconcile_t         state = recon.get_or_default();
+   CHECKC(state.phase == ReconPhase::NONE || state.phase == ReconPhase::DONE, err::STATE_MISMATCH,
+          "reconcile in progress: " + state.phase.to_string());
+
+   state.phase        = ReconPhase::CLEAR;
+   state.apply        = apply;
+   state.user         = name();
+   state.order_id     = 0;
+   state.key          = 0;
+   state.node_diffs   = 0;
+   state.invite_diffs = 0;
+   state.started_at   = current_time_point();
+   state.updated_at   = current_time_point();
+   recon.set(state, _self);
+}
+
+/// @brief advance the reconciliation by at most max_rows rows, only for admin
+/// @param max_rows - max rows to visit in this call
+/// differences are left in the recontally table, one row per mismatched node or inviter
+void agpu::recstep(const uint32_t& max_rows) {
+   require_auth(_gstate.admin);
+
+   CHECKC(max_rows > 0, err::PARAM_ERROR, "invalid max_rows" + to_string(max_rows));
+
+   reconcile_singleton recon(_self, _self.value);
+   CHECKC(recon.exists(), err::RECORD_NOT_FOUND, "reconcile not started");
+   reconcile_t state = recon.get();
+   CHECKC(state.phase != ReconPhase::NONE && state.phase != ReconPhase::DONE, err::STATE_MISMATCH, "reconcile not started");
+
+   uint32_t rows = 0;
+   if (state.phase == ReconPhase::CLEAR)
+      _recon_clear(state, rows, max_rows);
+   if (state.phase == ReconPhase::COUNT)
+      _recon_count(state, rows, max_rows);
+   if (state.phase == ReconPhase::NODES)
+      _recon_nodes(state, rows, max_rows);
+   if (state.phase == ReconPhase::INVITES)
+      _recon_invites(state, rows, max_rows);
+
+   state.updated_at = current_time_point();
+   recon.set(state, _self);
+}
+
+/// @brief erase the tallies left by the previous run
+void agpu::_recon_clear(reconcile_t& state, uint32_t& rows, const uint32_t& max_rows) {
+   for (const auto& scope : { ReconScope::NODE, ReconScope::INVITER }) {
+      recon_tally_t::tbl_t tallies(_self, scope.value);
+      auto                 itr = tallies.begin();
+      while (itr != tallies.end() && rows < max_rows) {
+         itr = tallies.erase(itr);
+         rows++;
+      }
+      if (itr != tallies.end())
+         return;
+   }
+
+   state.phase = ReconPhase::COUNT;
+}
+
+/// @brief recount orders by node and invitees by inviter, walking users through the invite table
+/// deleted nodes and inviters without a local invite row are not tallied, nothing would compare them
+void agpu::_recon_count(reconcile_t& state, uint32_t& rows, const uint32_t& max_rows) {
+   invite_t::tbl_t invites(_self, _self.value);
+   node_t::tbl_t   nodes(_self, _self.value);
+   auto            user_itr = invites.lower_bound(state.user.value);
+
+   while (user_itr != invites.end() && rows < max_rows) {
+      const name user    = user_itr->user;
+      const name inviter = user_itr->inviter;
+
+      // invitee is counted once, when its orders are entered from the first one
+      if constexpr (policy::counter == counter_t::INVITE) {
+         if (state.order_id == 0 && inviter != _gstate.bank && invites.find(inviter.value) != invites.end())
+            _recon_tally(ReconScope::INVITER, inviter.value, 1);
+      }
+
+      map<uint64_t, uint64_t> node_orders;
+      uint64_t                next_order_id = _scan_orders(user, state.order_id, [&](const order_t& order) {
+         if (rows >= max_rows)
+            return visit_t::STOP;
+         rows++;
+         node_orders[order.node_id] += 1;
+         return visit_t::NEXT;
+      });
+
+      for (const auto& [node_id, count] : node_orders) {
+         if (nodes.find(node_id) != nodes.end())
+            _recon_tally(ReconScope::NODE, node_id, count);
+      }
+
+      if (next_order_id != 0) {
+         state.user     = user;
+         state.order_id = next_order_id;
+         return;
+      }
+      rows++;
+
+      user_itr++;
+      state.user     = user_itr == invites.end() ? name() : user_itr->user;
+      state.order_id = 0;
+   }
+
+   if (user_itr == invites.end()) {
+      state.phase = ReconPhase::NODES;
+      state.key   = 0;
+   }
+}
+
+/// @brief compare recounted order totals with node total_saled
+void agpu::_recon_nodes(reconcile_t& state, uint32_t& rows, const uint32_t& max_rows) {
+   node_t::tbl_t        nodes(_self, _self.value);
+   recon_tally_t::tbl_t tallies(_self, ReconScope::NODE.value);
+   auto                 itr = nodes.lower_bound(state.key);
+
+   for (; itr != nodes.end() && rows < max_rows; itr++, rows++) {
+      auto     tally_itr = tallies.find(itr->node_id);
+      uint64_t counted   = tally_itr == tallies.end() ? 0 : tally_itr->counted;
+
+      // archived orders are erased, their accumulator still counts them
+      order_acc_t acc(itr->node_id);
+      if (_db.get(acc))
+         counted += acc.leaf_count;
+
+      if (counted == itr->total_saled) {
+         if (tally_itr != tallies.end())
+            tallies.erase(tally_itr);
+         continue;
+      }
+
+      state.node_diffs++;
+      recon_tally_t tally(itr->node_id);
+      tally.counted  = counted;
+      tally.recorded = itr->total_saled;
+      _db.set(ReconScope::NODE.value, tally, tally_itr != tallies.end());
+
+      if (state.apply) {
+         nodes.modify(itr, same_payer, [&](auto& node) {
+            node.total_saled = counted;
+            node.update_time = current_time_point();
+         });
+         _log_node(EventType::RECONCILE, *itr);
+      }
+   }
+
+   if (itr != nodes.end()) {
+      state.key = itr->node_id;
+      return;
+   }
+
+   // invite counters are not maintained, there is nothing to compare them with
+   state.phase = policy::counter == counter_t::INVITE ? ReconPhase::INVITES : ReconPhase::DONE;
+   state.key   = 0;
+}
+
+/// @brief compare recounted invitees with inviter invite_count
+void agpu::_recon_invites(reconcile_t& state, uint32_t& rows, const uint32_t& max_rows) {
+   invite_t::tbl_t      invites(_self, _self.value);
+   recon_tally_t::tbl_t tallies(_self, ReconScope::INVITER.value);
+   auto                 itr = invites.lower_bound(state.key);
+
+   for (; itr != invites.end() && rows < max_rows; itr++, rows++) {
+      auto     tally_itr = tallies.find(itr->user.value);
+      uint64_t counted   = tally_itr == tallies.end() ? 0 : tally_itr->counted;
+
+      if (counted == itr->invite_count) {
+         if (tally_itr != tallies.end())
+            tallies.erase(tally_itr);
+         // an applying run also backfills ranks of inviters counted before the ranking existed
+         if (state.apply)
+            _rank_inviter(*itr);
+         continue;
+      }
+
+      state.invite_diffs++;
+      recon_tally_t tally(itr->user.value);
+      tally.counted  = counted;
+      tally.recorded = itr->invite_count;
+      _db.set(ReconScope::INVITER.value, tally, tally_itr != tallies.end());
+
+      if (state.apply) {
+         invites.modify(itr, same_payer, [&](auto& invite) {
+            invite.invite_count = counted;
+            invite.update_time  = current_time_point();
+         });
+         _log_invite(EventType::RECONCILE, *itr);
+         _rank_inviter(*itr);
+      }
+   }
+
+   if (itr != invites.end()) {
+      state.key = itr->user.value;
+      return;
+   }
+
+   state.phase = ReconPhase::DONE;
+   state.key   = 0;
+}
+
+/// @brief add count to a recontally row
+void agpu::_recon_tally(const name& scope, const uint64_t& id, const uint64_t& count) {
+   recon_tally_t tally(id);
+   bool          found = _db.get(scope.value, tally);
+   tally.counted += count;
+   _db.set(scope.value, tally, found);
+}
+
+/// @brief refuse changes to orders and invites while an applying reconciliation runs
+/// its cursors would miss a change behind them and write a stale count back
+void agpu::_check_reconcile() {
+   reconcile_singleton recon(_self, _self.value);
+   if (!recon.exists())
+      return;
+
+   const reconcile_t state = recon.get();
+   CHECKC(!state.apply || state.phase == ReconPhase::NONE || state.phase == ReconPhase::DONE, err::STATE_MISMATCH,
+          "reconcile in progress: " + state.phase.to_string());
+}
+
+/// @brief set how long after creation an order is settled and may be archived, only for admin
+/// @param archive_delay - seconds, 0 disables archival
+void agpu::setarchive(const uint32_t& archive_delay) {
+   require_auth(_gstate.admin);
+
+   _conf.archive_delay = archive_delay;
+   _config.set(_conf, _self);
+}
+
+/// @brief fold settled orders into their node accumulator and erase them, only for admin
+/// users are walked through the invite table, a finished pass starts over from the first user
+/// @param max_rows - max rows to visit in this call
+void agpu::archive(const uint32_t& max_rows) {
+   require_auth(_gstate.admin);
+
+   CHECKC(_conf.archive_delay > 0, err::PAUSED, "archive disabled");
+   CHECKC(max_rows > 0, err::PARAM_ERROR, "invalid max_rows" + to_string(max_rows));
+   _check_reconcile();
+
+   archive_singleton arch(_self, _self.value);
+   archive_t         state  = arch.get_or_default();
+   const auto        cutoff = time_point_sec(current_time_point()) - _conf.archive_delay;
+
+   // accumulators touched by this batch, written back once; empty for nodes waiting for gcnode
+   map<uint64_t, optional<order_acc_t>> accs;
+   node_t::tbl_t                        nodes(_self, _self.value);
+
+   invite_t::tbl_t invites(_self, _self.value);
+   auto            user_itr = invites.lower_bound(state.user.value);
+   uint32_t        rows     = 0;
+
+   while (user_itr != invites.end() && rows < max_rows) {
+      const name user  = user_itr->user;
+      bool       fresh = false;
+
+      uint64_t next_order_id = _scan_orders(user, state.order_id, [&](const order_t& order) {
+         if (rows >= max_rows)
+            return visit_t::STOP;
+         // ids ascend with create time, every later order of the user is unsettled too
+         if (order.create_time > cutoff) {
+            fresh = true;
+            return visit_t::STOP;
+         }
+         rows++;
+
+         auto acc_itr = accs.find(order.node_id);
+         if (acc_itr == accs.end()) {
+            optional<order_acc_t> acc;
+            if (nodes.find(order.node_id) != nodes.end()) {
+               acc.emplace(order.node_id);
+               _db.get(*acc);
+            }
+            acc_itr = accs.emplace(order.node_id, acc).first;
+         }
+         if (!acc_itr->second)
+            return visit_t::NEXT;
+
+         order_acc_t& acc = *acc_itr->second;
+         wasm::merkle::append(acc.peaks, acc.leaf_count, _order_leaf(order));
+         _log_order(EventType::ARCHIVE, order, nullopt, nullopt, acc.leaf_count);
+         acc.leaf_count++;
+         state.archived++;
+         return visit_t::ERASE;
+      });
+
+      if (next_order_id != 0 && !fresh) {
+         state.user     = user;
+         state.order_id = next_order_id;
+         break;
+      }
+      rows++;
+
+      user_itr++;
+      state.user     = user_itr == invites.end() ? name() : user_itr->user;
+      state.order_id = 0;
+   }
+
+   if (user_itr == invites.end())
+      state.rounds++;
+
+   for (auto& [node_id, acc] : accs) {
+      if (!acc)
+         continue;
+      acc->root        = wasm::merkle::bag(acc->peaks);
+      acc->update_time = current_time_point();
+      _db.set(*acc);
+   }
+
+   state.updated_at = current_time_point();
+   arch.set(state, _self);
+}
+
+/// @brief check that an order was archived as the index-th leaf of its node accumulator
+/// @param index - leaf index, given by the ARCHIVE orderlog event
+/// @param order - archived order as it was logged
+/// @param proof - sibling hashes from the leaf up to its peak, lowest first
+void agpu::verifyorder(const uint64_t& index, const order_t& order, const vector<checksum256>& proof) {
+   order_acc_t acc(order.node_id);
+   CHECKC(_db.get(acc), err::RECORD_NOT_FOUND, "node accumulator not found: " + to_string(order.node_id));
+   CHECKC(index < acc.leaf_count, err::PARAM_ERROR, "invalid index" + to_string(index));
+   CHECKC(wasm::merkle::verify(acc.peaks, acc.leaf_count, index, _order_leaf(order), proof), err::PARAM_ERROR,
+          "invalid proof: " + to_string(order.order_id));
+}
+
+/// @brief accumulator leaf of an order
+checksum256 agpu::_order_leaf(const order_t& order) {
+   const auto data = pack(order);
+   return sha256(data.data(), data.size());
 }
 
 /// @brief signup action
@@ -130,9 +718,18 @@ void agpu::setnodestate(const uint64_t& node_id, const name& status) {
 void agpu::signup(const name& user, const name& inviter) {
    CHECKC(has_auth(user) || has_auth(_gstate.admin), err::PARAM_ERROR, "missing authority");
 
+   _signup(user, inviter);
+}
+
+/// @brief register a user under an inviter, shared by signup and the buy memo
+/// @param user - user account name
+/// @param inviter - inviter account name
+void agpu::_signup(const name& user, const name& inviter) {
    CHECKC(is_account(user), err::ACCOUNT_INVALID, "user not found: " + user.to_string())
    CHECKC(is_account(inviter), err::ACCOUNT_INVALID, "inviter not found: " + inviter.to_string())
    CHECKC(user != inviter, err::PARAM_ERROR, "user and inviter is same")
+   CHECKC(_is_local(user), err::STATE_MISMATCH, "user belongs to another shard: " + user.to_string())
+   _check_reconcile();
 
    invite_t use(user);
    CHECKC(!_db.get(use), err::RECORD_FOUND, "user invite is exist: " + user.to_string());
@@ -142,19 +739,26 @@ void agpu::signup(const name& user, const name& inviter) {
    use.create_time  = current_time_point();
    use.update_time  = current_time_point();
    _db.set(use);
-
-   if (inviter != _gstate.bank) {
-      user_mining_site_t::idx_t mining_site(ACPU_MINING, ACPU_MINING.value);
-      auto                      site_itr = mining_site.find(inviter.value);
-      CHECKC(site_itr != mining_site.end(), err::RECORD_NOT_FOUND, "invalid inviter");
-      CHECKC(site_itr->account == inviter, err::PARAM_ERROR, "inviter not match");
-      CHECKC(site_itr->level > 0, err::PARAM_ERROR, "invalid inviter level");
-
-      invite_t invite(inviter);
-      CHECKC(_db.get(invite), err::RECORD_NOT_FOUND, "inviter not exist: " + inviter.to_string());
-      invite.invite_count += 1;
-      invite.update_time = current_time_point();
-      _db.set(invite);
+   _log_invite(EventType::SIGNUP, use);
+   _add_subtree(user, 1);
+   _add_stat(0, 0, 0, 1);
+
+   if (inviter != _gstate.bank && !_is_local(inviter)) {
+      _check_inviter(inviter);
+      _check_remote_inviter(inviter);
+   } else if (inviter != _gstate.bank) {
+      _check_inviter(inviter);
+
+      auto invite = _db.find<invite_t>(inviter.value);
+      CHECKC(invite, err::RECORD_NOT_FOUND, "inviter not exist: " + inviter.to_string());
+      if constexpr (policy::counter == counter_t::INVITE) {
+         _db.modify(invite, [&](auto& row) {
+            row.invite_count += 1;
+            row.update_time = current_time_point();
+         });
+         _log_invite(EventType::INVITE, *invite);
+         _rank_inviter(*invite);
+      }
    }
 }
 
@@ -164,6 +768,8 @@ void agpu::signbind(const name& user, const name& inviter) {
    CHECKC(is_account(user), err::ACCOUNT_INVALID, "user not found: " + user.to_string())
    CHECKC(is_account(inviter), err::ACCOUNT_INVALID, "inviter not found: " + inviter.to_string())
    CHECKC(user != inviter, err::PARAM_ERROR, "user and inviter is same")
+   CHECKC(_is_local(user), err::STATE_MISMATCH, "user belongs to another shard: " + user.to_string())
+   _check_reconcile();
 
    invite_t use(user);
    CHECKC(!_db.get(use), err::RECORD_FOUND, "user invite is exist: " + user.to_string());
@@ -173,18 +779,28 @@ void agpu::signbind(const name& user, const name& inviter) {
    use.create_time  = current_time_point();
    use.update_time  = current_time_point();
    _db.set(use);
+   _log_invite(EventType::SIGNBIND, use);
+   _add_subtree(user, 1);
+   _add_stat(0, 0, 0, 1);
 
-   if (inviter != _gstate.bank) {
+   // an inviter of another shard is bound as is, its row lives on its own shard
+   if (inviter != _gstate.bank && _is_local(inviter)) {
       invite_t invite(inviter);
       if (!_db.get(invite)) {
          invite.inviter      = _gstate.bank;
-         invite.invite_count = 1;
+         invite.invite_count = policy::counter == counter_t::INVITE ? 1 : 0;
          invite.create_time  = current_time_point();
-      } else {
+         invite.update_time  = current_time_point();
+         _db.set(invite);
+         _log_invite(EventType::INVITE, invite);
+         _rank_inviter(invite);
+      } else if constexpr (policy::counter == counter_t::INVITE) {
          invite.invite_count += 1;
+         invite.update_time = current_time_point();
+         _db.set(invite);
+         _log_invite(EventType::INVITE, invite);
+         _rank_inviter(invite);
       }
-      invite.update_time = current_time_point();
-      _db.set(invite);
    }
 }
 
@@ -195,37 +811,51 @@ void agpu::signedit(const name& user, const name& inviter) {
    CHECKC(is_account(user), err::ACCOUNT_INVALID, "user not found: " + user.to_string())
    CHECKC(is_account(inviter), err::ACCOUNT_INVALID, "inviter not found: " + inviter.to_string())
    CHECKC(user != inviter, err::PARAM_ERROR, "user and inviter is same")
+   _check_reconcile();
 
    invite_t use(user);
    CHECKC(_db.get(use), err::RECORD_FOUND, "user invite not exist: " + user.to_string());
    name user_invite = use.inviter;
 
+   // the whole subtree moves from the old ancestors to the new ones
+   _add_subtree(user, -1);
    use.inviter     = inviter;
    use.update_time = current_time_point();
    _db.set(use);
+   _log_invite(EventType::SIGNEDIT, use);
+   _add_subtree(user, 1);
 
-   if (user_invite != _gstate.bank) {
-      invite_t old_invite(user_invite);
-      CHECKC(_db.get(old_invite), err::RECORD_FOUND, "user old invite not exist: " + user_invite.to_string());
+   if (user_invite != _gstate.bank && _is_local(user_invite)) {
+      auto old_invite = _db.find<invite_t>(user_invite.value);
+      CHECKC(old_invite, err::RECORD_FOUND, "user old invite not exist: " + user_invite.to_string());
       CHECKC(user_invite != inviter, err::PARAM_ERROR, "user.inviter and inviter is same")
 
-      old_invite.invite_count -= 1;
-      old_invite.update_time = current_time_point();
-      _db.set(old_invite);
+      if constexpr (policy::counter == counter_t::INVITE) {
+         _db.modify(old_invite, [&](auto& row) {
+            row.invite_count -= 1;
+            row.update_time = current_time_point();
+         });
+         _log_invite(EventType::INVITE, *old_invite);
+         _rank_inviter(*old_invite);
+      }
    }
 
-   if (inviter != _gstate.bank) {
-      user_mining_site_t::idx_t mining_site(ACPU_MINING, ACPU_MINING.value);
-      auto                      site_itr = mining_site.find(inviter.value);
-      CHECKC(site_itr != mining_site.end(), err::RECORD_NOT_FOUND, "invalid inviter");
-      CHECKC(site_itr->account == inviter, err::PARAM_ERROR, "inviter not match");
-      CHECKC(site_itr->level > 0, err::PARAM_ERROR, "invalid inviter level");
-
-      invite_t invite(inviter);
-      CHECKC(_db.get(invite), err::RECORD_NOT_FOUND, "inviter not exist: " + inviter.to_string());
-      invite.invite_count += 1;
-      invite.update_time = current_time_point();
-      _db.set(invite);
+   if (inviter != _gstate.bank && !_is_local(inviter)) {
+      _check_inviter(inviter);
+      _check_remote_inviter(inviter);
+   } else if (inviter != _gstate.bank) {
+      _check_inviter(inviter);
+
+      auto invite = _db.find<invite_t>(inviter.value);
+      CHECKC(invite, err::RECORD_NOT_FOUND, "inviter not exist: " + inviter.to_string());
+      if constexpr (policy::counter == counter_t::INVITE) {
+         _db.modify(invite, [&](auto& row) {
+            row.invite_count += 1;
+            row.update_time = current_time_point();
+         });
+         _log_invite(EventType::INVITE, *invite);
+         _rank_inviter(*invite);
+      }
    }
 }
 
@@ -234,18 +864,49 @@ void agpu::signdel(const name& user) {
    require_auth(_gstate.admin);
 
    CHECKC(is_account(user), err::ACCOUNT_INVALID, "user not found: " + user.to_string())
+   _check_reconcile();
 
    invite_t use(user);
    CHECKC(_db.get(use), err::RECORD_NOT_FOUND, "user invite is not exist: " + user.to_string());
 
+   // gcnode and archive reach the rows of a user through its invite row
+   CHECKC(!_has_rows(user), err::STATE_MISMATCH, "user still has orders or node totals: " + user.to_string());
+
+   // invitees of the user lose their path to the ancestors, so the subtree leaves their teams
+   _add_subtree(user, -1);
    _db.del(use);
+   _log_invite(EventType::SIGNDEL, use);
+
+   invite_rank_t rank(user);
+   _db.del(rank);
+}
+
+/// @brief set how long an inviter eligibility stays cached, only for admin
+/// @param eligible_ttl - seconds, 0 disables the cache
+void agpu::seteligttl(const uint32_t& eligible_ttl) {
+   require_auth(_gstate.admin);
+
+   _conf.eligible_ttl = eligible_ttl;
+   _config.set(_conf, _self);
+}
+
+/// @brief invalidate the cached eligibility of an inviter, only for admin
+/// @param inviter - inviter account name
+void agpu::clrelig(const name& inviter) {
+   require_auth(_gstate.admin);
+
+   auto eligible = _db.find<eligible_t>(inviter.value);
+   CHECKC(eligible, err::RECORD_NOT_FOUND, "inviter eligibility not cached: " + inviter.to_string());
+
+   _db.erase(eligible);
 }
 
 /// @brief buy node action
 /// @param from - from account name
 /// @param to - to account name
 /// @param quantity - transfer quantity
-/// @param memo - buy:node_id
+/// @param memo - buy:node_id[:inviter], preorder:node_id or deposit
+/// a buy naming an inviter signs up a buyer without an invite row first
 void agpu::on_transfer(const name& from, const name& to, const asset& quantity, const string& memo) {
    if (from == _self || to != _self)
       return;
@@ -254,30 +915,83 @@ void agpu::on_transfer(const name& from, const name& to, const asset& quantity,
    CHECKC(is_account(to), err::ACCOUNT_INVALID, "to not found: " + to.to_string())
    CHECKC(quantity.is_valid() && quantity.amount > 0, err::QUANTITY_INVALID, "invalid quantity")
 
-   auto params = split(memo, ":");
-   CHECKC(params.size() >= 2, err::MEMO_FORMAT_ERROR, "invalid memo");
+   // node, invite, order and node total rows are read and written several times per buy
+   _db.enable_cache();
+
+   auto params      = split(memo, ":");
    auto action_name = name(params[0]);
-   auto node_id     = uint64_t(atoi(params[1].data()));
 
-   node_t node(node_id);
-   CHECKC(_db.get(node), err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id))
+   // a deposit tops up the balance spent by the buy action, it names no node
+   if (action_name == "deposit"_n) {
+      CHECKC(get_first_receiver() == _gstate.usdt_contract, err::PARAM_ERROR,
+             "invalid usdt contract" + _gstate.usdt_contract.to_string());
+      CHECKC(quantity.symbol == _gstate.usdt_symbol, err::SYMBOL_MISMATCH, "invalid usdt symbol: " + quantity.symbol.code().to_string());
+
+      _add_balance(from, quantity);
+      return;
+   }
+
+   CHECKC(params.size() >= 2, err::MEMO_FORMAT_ERROR, "invalid memo");
+   auto node_id = uint64_t(atoi(params[1].data()));
+
+   auto node = _db.find<node_t>(node_id);
+   CHECKC(node, err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id))
 
    switch (action_name.value) {
       case "buy"_n.value: {
          CHECKC(get_first_receiver() == _gstate.usdt_contract, err::PARAM_ERROR,
                 "invalid usdt contract" + _gstate.usdt_contract.to_string());
          CHECKC(quantity.symbol == _gstate.usdt_symbol, err::SYMBOL_MISMATCH, "invalid usdt symbol: " + quantity.symbol.code().to_string());
-         CHECKC(quantity.amount == node.price.amount, err::QUANTITY_INVALID, "invalid quantity: " + quantity.to_string());
-         CHECKC(node.status == NodeStatus::ENABLE, err::PARAM_ERROR, "node not enable: " + to_string(node_id));
-         CHECKC(node.start_time < current_time_point(), err::PARAM_ERROR, "node not start: " + to_string(node_id));
-         CHECKC(node.total_saled + 1 <= node.max_sale, err::OVERSIZED, "node saled count exceeded: " + to_string(node.max_sale));
-
-         TRANSFER(get_first_receiver(), _gstate.bank, quantity, memo);
-
-         node.total_saled += 1;
-         _db.set(node);
-
-         _buy(node_id, from, quantity);
+         CHECKC(node->status == NodeStatus::ENABLE, err::PARAM_ERROR, "node not enable: " + to_string(node_id));
+         CHECKC(node->start_time < current_time_point(), err::PARAM_ERROR, "node not start: " + to_string(node_id));
+         CHECKC(quantity == _quote(*node, 1), err::QUANTITY_INVALID, "invalid quantity: " + quantity.to_string());
+         CHECKC(node->total_saled + 1 <= node->max_sale, err::OVERSIZED, "node saled count exceeded: " + to_string(node->max_sale));
+
+         // queued preorders are served first, direct buys wait until allocate drained them
+         preorder_t::tbl_t preorders(_self, node_id);
+         CHECKC(preorders.begin() == preorders.end(), err::STATE_MISMATCH, "node preorders pending: " + to_string(node_id));
+
+         // the inviter of an already signed up buyer is ignored, signedit is the only way to change it
+         if (params.size() >= 3) {
+            invite_inviter_t invite;
+            if (!_db.get_projection<invite_t>(_self.value, from.value, invite))
+               _signup(from, name(params[2]));
+         }
+         _check_allowlist(node_id, from, 1);
+
+         _db.modify(node, [&](auto& row) { row.total_saled += 1; });
+
+         const order_t order = _buy(*node, from, quantity, EventType::BUY);
+         _settle(get_first_receiver(), quantity - _add_commission(order), memo);
+         break;
+      }
+      case "preorder"_n.value: {
+         CHECKC(get_first_receiver() == _gstate.usdt_contract, err::PARAM_ERROR,
+                "invalid usdt contract" + _gstate.usdt_contract.to_string());
+         CHECKC(quantity.symbol == _gstate.usdt_symbol, err::SYMBOL_MISMATCH, "invalid usdt symbol: " + quantity.symbol.code().to_string());
+         CHECKC(quantity.amount % node->price.amount == 0, err::QUANTITY_INVALID, "invalid quantity: " + quantity.to_string());
+         pricing_t pricing(node_id);
+         CHECKC(!_db.get(pricing), err::STATE_MISMATCH, "priced node takes no preorders: " + to_string(node_id));
+         CHECKC(node->status == NodeStatus::ENABLE, err::PARAM_ERROR, "node not enable: " + to_string(node_id));
+         CHECKC(node->start_time > current_time_point(), err::PARAM_ERROR, "node already started: " + to_string(node_id));
+
+         const uint64_t count = quantity.amount / node->price.amount;
+         CHECKC(count <= MAX_PREORDER_UNITS, err::OVERSIZED, "preorder units exceeded: " + to_string(MAX_PREORDER_UNITS));
+
+         invite_inviter_t invite;
+         CHECKC(_db.get_projection<invite_t>(_self.value, from.value, invite), err::RECORD_NOT_FOUND,
+                "user invite not found: " + from.to_string());
+         CHECKC(_is_local(from), err::STATE_MISMATCH, "user belongs to another shard: " + from.to_string())
+         _check_allowlist(node_id, from, count);
+
+         // the payment stays in the contract until allocate settles it or credits it back to the balance
+         preorder_t::tbl_t preorders(_self, node_id);
+         preorder_t        preorder(preorders.available_primary_key());
+         preorder.user        = from;
+         preorder.count       = count;
+         preorder.quantity    = quantity;
+         preorder.create_time = current_time_point();
+         _db.insert(node_id, preorder);
          break;
       }
       default: {
@@ -288,36 +1002,351 @@ void agpu::on_transfer(const name& from, const name& to, const asset& quantity,
 }
 
 /// @brief buy node helper function
-/// @param node_id - node id
+/// @param node - bought node, total_saled already counts this buy
 /// @param user - user account name
 /// @param quantity - transfer quantity
-void agpu::_buy(const uint64_t& node_id, const name& user, const asset& quantity) {
-   invite_t invite(user);
-   CHECKC(_db.get(invite), err::RECORD_NOT_FOUND, "user invite not found: " + user.to_string());
+/// @param event - logged event type
+/// @return created order
+order_t agpu::_buy(const node_t& node, const name& user, const asset& quantity, const name& event) {
+   CHECKC(_is_local(user), err::STATE_MISMATCH, "user belongs to another shard: " + user.to_string())
+   _check_reconcile();
 
+   invite_inviter_t invite;
+   CHECKC(_db.get_projection<invite_t>(_self.value, user.value, invite), err::RECORD_NOT_FOUND, "user invite not found: " + user.to_string());
+
+   // order ids are monotonic, the row can not exist yet
    uint64_t order_id = ++_gstate.order_id;
    order_t  order(order_id);
-   CHECKC(!_db.get(user.value, order), err::RECORD_FOUND, "order found: " + to_string(order_id));
-
-   order.node_id     = node_id;
+   order.node_id     = node.node_id;
    order.user        = user;
    order.inviter     = invite.inviter;
    order.price       = quantity;
    order.create_time = current_time_point();
-   _db.set(user.value, order, false);
-
-   node_total_t node_total(node_id);
-   if (!_db.get(user.value, node_total)) {
-      node_total.node_id     = node_id;
-      node_total.total       = 1;
-      node_total.create_time = current_time_point();
-      node_total.update_time = current_time_point();
-      _db.set(user.value, node_total, false);
-   } else {
-      node_total.total += 1;
-      node_total.update_time = current_time_point();
-      _db.set(user.value, node_total, true);
+   const name payer = _ram_payer(user);
+   order_v2_t row(order);
+   if (payer != _self)
+      row.ram_payer.emplace(payer);
+   _db.insert(user.value, row, payer);
+   _account_ram(payer, 1, pack_size(row));
+
+   uint64_t holding = _add_node_total(user, node.node_id, 1);
+   _add_team_orders(user, 1);
+   _add_inviter_sale(order, 1);
+   _add_stat(order.node_id, 1, 0, 0);
+   _log_order(event, order, node.total_saled, holding, nullopt);
+   return order;
+}
+
+/// @brief find and erase an order in either encoding
+/// @param user - user account name
+/// @param order_id - order id
+/// @param order - decoded order when found
+bool agpu::_del_order(const name& user, const uint64_t& order_id, order_t& order) {
+   auto compact = _db.find<order_v2_t>(user.value, order_id);
+   if (compact) {
+      order = compact->to_order(user, _gstate.usdt_symbol);
+      _account_ram(compact->ram_payer.value_or(_self), -1, -int64_t(pack_size(*compact)));
+      _db.erase(compact);
+      return true;
+   }
+
+   auto legacy = _db.find<order_t>(user.value, order_id);
+   if (legacy) {
+      order = *legacy;
+      _db.erase(legacy);
+      return true;
+   }
+   return false;
+}
+
+/// @brief add count to the node total of a user, a legacy row is updated in place
+/// @param user - user account name
+/// @param node_id - node id
+/// @param count - bought (positive) or removed (negative) count
+/// @return user total of the node after the update
+uint64_t agpu::_add_node_total(const name& user, const uint64_t& node_id, const int64_t& count) {
+   if (_conf.portfolio)
+      return _add_portfolio(user, node_id, count);
+
+   auto compact = _db.find<node_total_v2_t>(user.value, node_id);
+   if (compact) {
+      _db.modify(compact, [&](auto& row) {
+         row.total += count;
+         row.update_time = current_time_point();
+      });
+      return compact->total;
+   }
+
+   auto legacy = _db.find<node_total_t>(user.value, node_id);
+   if (legacy) {
+      _db.modify(legacy, [&](auto& row) {
+         row.total += count;
+         row.update_time = current_time_point();
+      });
+      return legacy->total;
+   }
+
+   CHECKC(count > 0, err::RECORD_NOT_FOUND, "node total not found: " + to_string(node_id));
+   node_total_v2_t total(node_id);
+   total.total       = count;
+   total.update_time = current_time_point();
+
+   const name payer = _ram_payer(user);
+   if (payer != _self)
+      total.ram_payer.emplace(payer);
+   _db.insert(user.value, total, payer);
+   _account_ram(payer, 1, pack_size(total));
+   return total.total;
+}
+
+/// @brief erase the node total of a user in either encoding
+/// @param user - user account name
+/// @param node_id - node id
+bool agpu::_del_node_total(const name& user, const uint64_t& node_id) {
+   if (_conf.portfolio && _del_portfolio(user, node_id))
+      return true;
+
+   auto compact = _db.find<node_total_v2_t>(user.value, node_id);
+   if (compact) {
+      _account_ram(compact->ram_payer.value_or(_self), -1, -int64_t(pack_size(*compact)));
+      _db.erase(compact);
+      return true;
+   }
+
+   auto legacy = _db.find<node_total_t>(user.value, node_id);
+   if (legacy) {
+      _db.erase(legacy);
+      return true;
+   }
+   return false;
+}
+
+/// @brief whether a user still owns orders or node totals in any encoding
+/// @param user - user account name
+bool agpu::_has_rows(const name& user) {
+   order_t::tbl_t legacy_orders(_self, user.value);
+   order_v2_t::tbl_t orders(_self, user.value);
+   if (legacy_orders.begin() != legacy_orders.end() || orders.begin() != orders.end())
+      return true;
+
+   node_total_t::tbl_t    legacy_totals(_self, user.value);
+   node_total_v2_t::tbl_t totals(_self, user.value);
+   if (legacy_totals.begin() != legacy_totals.end() || totals.begin() != totals.end())
+      return true;
+
+   portfolio_t portfolio(user);
+   return _db.get(portfolio);
+}
+
+/// @brief validate a new inviter with the referral validator of the policy
+/// @param inviter - inviter account name
+void agpu::_check_inviter(const name& inviter) {
+   if constexpr (policy::referral == referral_t::MINING_SITE) {
+      // rows cached before seteligttl(0) are not trusted either
+      auto eligible = _db.find<eligible_t>(inviter.value);
+      if (_conf.eligible_ttl > 0 && eligible && eligible->expire_time > current_time_point())
+         return;
+
+      // only account and level are decoded out of the 13 usermisite fields
+      user_mining_level_t site;
+      CHECKC(get_projection(ACPU_MINING, ACPU_MINING.value, user_mining_site_t::idx_t::table_name(), inviter.value, site),
+             err::RECORD_NOT_FOUND, "invalid inviter");
+      CHECKC(site.account == inviter, err::PARAM_ERROR, "inviter not match");
+      CHECKC(site.level > 0, err::PARAM_ERROR, "invalid inviter level");
+
+      if (_conf.eligible_ttl == 0)
+         return;
+
+      const auto expire_time = time_point_sec(current_time_point()) + _conf.eligible_ttl;
+      if (eligible) {
+         _db.modify(eligible, [&](auto& row) {
+            row.level       = site.level;
+            row.expire_time = expire_time;
+         });
+      } else {
+         eligible_t row(inviter);
+         row.level       = site.level;
+         row.expire_time = expire_time;
+         _db.insert(_self.value, row);
+      }
+   }
+}
+
+/// @brief count units against the proved allowlist cap of a user, nodes without an allowlist are open
+/// @param node_id - node id
+/// @param user - user account name
+/// @param count - units bought or preordered
+void agpu::_check_allowlist(const uint64_t& node_id, const name& user, const uint64_t& count) {
+   allowlist_t allowlist(node_id);
+   if (!_db.get(allowlist))
+      return;
+
+   allowed_t allowed(user);
+   CHECKC(_db.get(node_id, allowed), err::NO_AUTH, "allowlist entry not proved: " + user.to_string());
+   CHECKC(allowed.bought + count <= allowed.cap, err::OVERSIZED, "allowlist cap exceeded: " + to_string(allowed.cap));
+
+   allowed.bought += count;
+   _db.set(node_id, allowed, true);
+}
+
+/// @brief give back allowlist capacity counted by _check_allowlist for units that were refunded
+/// @param node_id - node id
+/// @param user - user account name
+/// @param count - refunded units
+void agpu::_release_allowlist(const uint64_t& node_id, const name& user, const uint64_t& count) {
+   allowed_t allowed(user);
+   if (!_db.get(node_id, allowed))
+      return;
+
+   allowed.bought -= min(allowed.bought, count);
+   _db.set(node_id, allowed, true);
+}
+
+/// @brief settle a buy payment with the settlement strategy of the policy
+/// a forwarding build accrues payments instead while a sweep interval is set, sweep moves them in one transfer
+/// @param token_contract - usdt contract account name
+/// @param quantity - payment quantity
+/// @param memo - forwarded memo
+void agpu::_settle(const name& token_contract, const asset& quantity, const string& memo) {
+   if constexpr (policy::settlement == settlement_t::FORWARD) {
+      // commissions may take the whole payment
+      if (quantity.amount == 0)
+         return;
+
+      accrual_singleton accrual(_self, _self.value);
+      accrual_t         state = accrual.get_or_default();
+      if (state.sweep_interval == 0) {
+         TRANSFER(token_contract, _gstate.bank, quantity, memo);
+         return;
+      }
+
+      if (state.accrued.symbol.raw() == 0) {
+         state.pending = asset(0, quantity.symbol);
+         state.accrued = asset(0, quantity.symbol);
+         state.swept   = asset(0, quantity.symbol);
+      }
+      state.pending += quantity;
+      state.accrued += quantity;
+      state.updated_at = current_time_point();
+      accrual.set(state, _self);
+   }
+}
+
+/// @brief accrue the commissions of a paid order to the inviters above its buyer
+/// the first level is the inviter recorded on the order, higher levels follow the invite rows
+/// @param order - paid order
+/// @return commissions accrued, kept in the contract until claimed
+asset agpu::_add_commission(const order_t& order) {
+   safe<int64_t> total = 0;
+
+   commission_rate_t rate(order.node_id);
+   if (!_db.get(rate)) {
+      rate = commission_rate_t(0);
+      _db.get(rate);
+   }
+
+   name inviter = order.inviter;
+   for (size_t level = 0; level < rate.rates.size() && inviter && inviter != _gstate.bank; level++) {
+      const safe<int64_t> amount = safe<int64_t>(order.price.amount) * rate.rates[level] / RATIO_BOOST;
+      if (amount > 0) {
+         commission_t commission(inviter);
+         if (!_db.get(commission)) {
+            commission.claimable = asset(0, order.price.symbol);
+            commission.claimed   = asset(0, order.price.symbol);
+         }
+         commission.claimable.amount = (safe<int64_t>(commission.claimable.amount) + amount).value;
+         commission.update_time      = current_time_point();
+         _db.set(commission);
+         total += amount;
+      }
+
+      invite_inviter_t invite;
+      if (!_db.get_projection<invite_t>(_self.value, inviter.value, invite))
+         break;
+      inviter = invite.inviter;
+   }
+
+   return asset(total.value, order.price.symbol);
+}
+
+/// @brief set the commission rates of a node, only for admin
+/// @param node_id - node id, 0 for the default of nodes without their own rates
+/// @param rates - share of each inviter level in RATIO_BOOST, empty to remove the rates
+void agpu::setcommrate(const uint64_t& node_id, const vector<uint16_t>& rates) {
+   require_auth(_gstate.admin);
+
+   CHECKC(rates.size() <= MAX_COMMISSION_LEVELS, err::OVERSIZED, "commission levels exceeded: " + to_string(MAX_COMMISSION_LEVELS));
+   uint32_t sum = 0;
+   for (const auto& r : rates)
+      sum += r;
+   CHECKC(sum <= RATIO_BOOST, err::RATE_EXCEEDED, "commission rates exceed the price: " + to_string(sum));
+
+   commission_rate_t rate(node_id);
+   if (rates.empty()) {
+      CHECKC(_db.get(rate), err::RECORD_NOT_FOUND, "commission rates not found: " + to_string(node_id));
+      _db.del(rate);
+      return;
    }
+
+   rate.rates = rates;
+   _db.set(rate);
+}
+
+/// @brief pay out the accrued commissions of an inviter
+/// @param inviter - inviter account name
+void agpu::claim(const name& inviter) {
+   require_auth(inviter);
+
+   commission_t commission(inviter);
+   CHECKC(_db.get(commission), err::RECORD_NOT_FOUND, "commission not found: " + inviter.to_string());
+   CHECKC(commission.claimable.amount > 0, err::NOT_POSITIVE, "nothing to claim");
+
+   TRANSFER(_gstate.usdt_contract, inviter, commission.claimable, "commission");
+
+   commission.claimed += commission.claimable;
+   commission.claimable.amount = 0;
+   commission.update_time      = current_time_point();
+   _db.set(commission);
+}
+
+/// @brief set the deferred settlement of payments, only for admin
+/// @param sweep_interval - seconds between sweeps, 0 forwards every payment inline again
+/// @param sweep_threshold - accrued amount that allows a sweep before the interval ends, 0 disables it
+void agpu::setsweep(const uint32_t& sweep_interval, const int64_t& sweep_threshold) {
+   require_auth(_gstate.admin);
+
+   CHECKC(policy::settlement == settlement_t::FORWARD, err::STATE_MISMATCH, "payments are not forwarded");
+   CHECKC(sweep_threshold >= 0, err::PARAM_ERROR, "invalid sweep_threshold" + to_string(sweep_threshold));
+
+   accrual_singleton accrual(_self, _self.value);
+   accrual_t         state = accrual.get_or_default();
+
+   state.sweep_interval  = sweep_interval;
+   state.sweep_threshold = sweep_threshold;
+   accrual.set(state, _self);
+}
+
+/// @brief move the accrued payments to the bank in one transfer, anyone may call it
+/// at most once per sweep interval, or earlier once the accrued amount reaches the threshold
+void agpu::sweep() {
+   accrual_singleton accrual(_self, _self.value);
+   CHECKC(accrual.exists(), err::RECORD_NOT_FOUND, "nothing accrued");
+   accrual_t state = accrual.get();
+   CHECKC(state.pending.amount > 0, err::NOT_POSITIVE, "nothing accrued");
+
+   const auto now     = time_point_sec(current_time_point());
+   const bool due     = now >= state.last_sweep + state.sweep_interval;
+   const bool reached = state.sweep_threshold > 0 && state.pending.amount >= state.sweep_threshold;
+   CHECKC(due || reached, err::TIME_NOT_EXPIRED, "sweep not due");
+
+   state.sweeps++;
+   TRANSFER(_gstate.usdt_contract, _gstate.bank, state.pending, "sweep:" + to_string(state.sweeps));
+
+   state.swept += state.pending;
+   state.pending.amount = 0;
+   state.last_sweep     = now;
+   state.updated_at     = now;
+   accrual.set(state, _self);
 }
 
 /// @brief add order action only for admin
@@ -331,18 +1360,209 @@ void agpu::addorder(const uint64_t& node_id, const name& user, const asset& quan
    CHECKC(is_account(user), err::ACCOUNT_INVALID, "user not found: " + user.to_string());
    CHECKC(quantity.is_valid() && quantity.amount > 0, err::QUANTITY_INVALID, "invalid quantity")
 
-   node_t node(node_id);
-   CHECKC(_db.get(node), err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id))
+   _db.enable_cache();
+
+   auto node = _db.find<node_t>(node_id);
+   CHECKC(node, err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id))
 
    CHECKC(quantity.symbol == _gstate.usdt_symbol, err::SYMBOL_MISMATCH, "invalid usdt symbol: " + quantity.symbol.code().to_string());
-   CHECKC(quantity.amount == node.price.amount, err::QUANTITY_INVALID, "invalid quantity: " + quantity.to_string());
-   CHECKC(node.status == NodeStatus::ENABLE, err::PARAM_ERROR, "node not enable: " + to_string(node_id));
-   CHECKC(node.total_saled + 1 <= node.max_sale, err::OVERSIZED, "node saled count exceeded: " + to_string(node.max_sale));
+   CHECKC(quantity == _quote(*node, 1), err::QUANTITY_INVALID, "invalid quantity: " + quantity.to_string());
+   CHECKC(node->status == NodeStatus::ENABLE, err::PARAM_ERROR, "node not enable: " + to_string(node_id));
+   CHECKC(node->total_saled + 1 <= node->max_sale, err::OVERSIZED, "node saled count exceeded: " + to_string(node->max_sale));
 
-   node.total_saled += 1;
-   _db.set(node);
+   // queued preorders are served first, like buy and the transfer buy
+   preorder_t::tbl_t preorders(_self, node_id);
+   CHECKC(preorders.begin() == preorders.end(), err::STATE_MISMATCH, "node preorders pending: " + to_string(node_id));
 
-   _buy(node_id, user, quantity);
+   _db.modify(node, [&](auto& row) { row.total_saled += 1; });
+
+   _buy(*node, user, quantity, EventType::ADDORDER);
+}
+
+/// @brief allocate queued preorders of a started node in arrival order
+/// units left unallocated are credited to the balance of their buyer, who withdraws them, a push
+/// transfer could be rejected by the buyer and block the queue
+/// anyone may call it, a call handles at most max_rows preorders
+/// @param node_id - node id
+/// @param max_rows - max preorders to handle in this call
+void agpu::allocate(const uint64_t& node_id, const uint32_t& max_rows) {
+   CHECKC(max_rows > 0, err::PARAM_ERROR, "invalid max_rows" + to_string(max_rows));
+
+   _db.enable_cache();
+
+   preorder_t::tbl_t preorders(_self, node_id);
+   auto              itr = preorders.begin();
+   CHECKC(itr != preorders.end(), err::RECORD_NOT_FOUND, "no preorders: " + to_string(node_id));
+
+   // a deleted or disabled node can not be allocated, its queue is only refunded
+   auto node = _db.find<node_t>(node_id);
+   bool open = node && node->status == NodeStatus::ENABLE;
+   CHECKC(!open || node->start_time <= current_time_point(), err::NOT_STARTED, "node not start: " + to_string(node_id));
+
+   for (uint32_t rows = 0; itr != preorders.end() && rows < max_rows; rows++) {
+      const preorder_t preorder = *itr;
+      itr                       = preorders.erase(itr);
+
+      const asset price = preorder.quantity / preorder.count;
+      uint64_t    units = 0;
+      if (open) {
+         invite_inviter_t invite;
+         if (_db.get_projection<invite_t>(_self.value, preorder.user.value, invite) && node->total_saled < node->max_sale)
+            units = min(preorder.count, node->max_sale - node->total_saled);
+      }
+
+      asset proceeds = price * units;
+      for (uint64_t i = 0; i < units; i++) {
+         _db.modify(node, [&](auto& row) { row.total_saled += 1; });
+         proceeds -= _add_commission(_buy(*node, preorder.user, price, EventType::PREORDER));
+      }
+
+      if (units > 0)
+         _settle(_gstate.usdt_contract, proceeds, "preorder:" + to_string(node_id));
+      if (units < preorder.count) {
+         _add_balance(preorder.user, price * (preorder.count - units));
+         _release_allowlist(node_id, preorder.user, preorder.count - units);
+      }
+   }
+}
+
+/// @brief buy nodes with the deposited balance of the user
+/// @param user - user account name
+/// @param node_id - node id
+/// @param count - units to buy
+void agpu::buy(const name& user, const uint64_t& node_id, const uint64_t& count) {
+   require_auth(user);
+
+   CHECKC(count > 0 && count <= MAX_BUY_UNITS, err::PARAM_ERROR, "invalid count" + to_string(count));
+
+   _db.enable_cache();
+
+   auto node = _db.find<node_t>(node_id);
+   CHECKC(node, err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id))
+   CHECKC(node->price.symbol == _gstate.usdt_symbol, err::SYMBOL_MISMATCH, "invalid node price: " + node->price.to_string());
+   CHECKC(node->status == NodeStatus::ENABLE, err::PARAM_ERROR, "node not enable: " + to_string(node_id));
+   CHECKC(node->start_time < current_time_point(), err::PARAM_ERROR, "node not start: " + to_string(node_id));
+   CHECKC(node->total_saled + count <= node->max_sale, err::OVERSIZED, "node saled count exceeded: " + to_string(node->max_sale));
+
+   preorder_t::tbl_t preorders(_self, node_id);
+   CHECKC(preorders.begin() == preorders.end(), err::STATE_MISMATCH, "node preorders pending: " + to_string(node_id));
+
+   _check_allowlist(node_id, user, count);
+
+   const asset cost = _quote(*node, count);
+   _add_balance(user, -cost);
+
+   // unit quotes telescope, so the orders add up to cost exactly
+   asset proceeds = cost;
+   for (uint64_t i = 0; i < count; i++) {
+      const asset price = _quote(*node, 1);
+      _db.modify(node, [&](auto& row) { row.total_saled += 1; });
+      proceeds -= _add_commission(_buy(*node, user, price, EventType::BUY));
+   }
+   _settle(_gstate.usdt_contract, proceeds, "buy:" + to_string(node_id));
+}
+
+/// @brief withdraw part of the deposited balance
+/// @param user - user account name
+/// @param quantity - withdrawn quantity
+void agpu::withdraw(const name& user, const asset& quantity) {
+   require_auth(user);
+
+   CHECKC(quantity.is_valid() && quantity.amount > 0, err::QUANTITY_INVALID, "invalid quantity")
+   CHECKC(quantity.symbol == _gstate.usdt_symbol, err::SYMBOL_MISMATCH, "invalid usdt symbol: " + quantity.symbol.code().to_string());
+
+   _add_balance(user, -quantity);
+   TRANSFER(_gstate.usdt_contract, user, quantity, "withdraw");
+}
+
+/// @brief return the whole deposited balance of a user, only for admin
+/// @param user - user account name
+void agpu::refund(const name& user) {
+   require_auth(_gstate.admin);
+
+   balance_t balance(user);
+   CHECKC(_db.get(balance), err::RECORD_NOT_FOUND, "balance not found: " + user.to_string());
+
+   _db.del(balance);
+   TRANSFER(_gstate.usdt_contract, user, balance.balance, "refund");
+}
+
+/// @brief add a deposit (positive) or a debit (negative) to the balance of a user
+/// the row goes away when it reaches zero
+/// @param user - user account name
+/// @param quantity - usdt quantity
+void agpu::_add_balance(const name& user, const asset& quantity) {
+   balance_t  balance(user);
+   const bool found = _db.get(balance);
+   if (!found)
+      balance.balance = asset(0, quantity.symbol);
+
+   CHECKC(balance.balance.amount + quantity.amount >= 0, err::FEE_INSUFFICIENT, "insufficient balance: " + balance.balance.to_string());
+   balance.balance += quantity;
+   if (balance.balance.amount == 0) {
+      if (found)
+         _db.del(balance);
+      return;
+   }
+
+   balance.update_time = current_time_point();
+   _db.set(balance);
+}
+
+/// @brief set the key that signs purchase vouchers and the chain they are valid on, only for admin
+/// @param voucher_key - public key, an empty key turns vouchers off
+/// @param voucher_chain - id of the chain this contract runs on
+void agpu::setvoucher(const public_key& voucher_key, const checksum256& voucher_chain) {
+   require_auth(_gstate.admin);
+
+   CHECKC(voucher_key == public_key() || voucher_chain != checksum256(), err::PARAM_ERROR, "missing voucher_chain");
+   _conf.voucher_key   = voucher_key;
+   _conf.voucher_chain = voucher_chain;
+   _config.set(_conf, _self);
+}
+
+/// @brief redeem an admin signed voucher for orders, the user signs and pays for it instead of the admin
+/// @param voucher - signed voucher
+/// @param sig - signature of sha256(pack(voucher)) by config_t::voucher_key
+void agpu::redeem(const voucher_t& voucher, const signature& sig) {
+   require_auth(voucher.user);
+
+   CHECKC(_conf.voucher_key != public_key(), err::PAUSED, "vouchers disabled");
+   CHECKC(voucher.chain_id == _conf.voucher_chain, err::PARAM_ERROR, "voucher of another chain");
+   CHECKC(voucher.contract == _self, err::PARAM_ERROR, "voucher of another contract: " + voucher.contract.to_string());
+   CHECKC(voucher.expiry >= current_time_point().sec_since_epoch(), err::TIME_EXPIRED, "voucher expired: " + to_string(voucher.nonce));
+   CHECKC(voucher.count > 0 && voucher.count <= MAX_BUY_UNITS, err::PARAM_ERROR, "invalid count" + to_string(voucher.count));
+
+   const auto data = pack(voucher);
+   assert_recover_key(sha256(data.data(), data.size()), sig, _conf.voucher_key);
+
+   voucher_bits_t bits(voucher.nonce / VOUCHER_BATCH_BITS);
+   const bool     found = _db.get(bits);
+   if (!found)
+      bits.bits.resize(VOUCHER_BATCH_BITS / 64);
+   const uint64_t bit  = voucher.nonce % VOUCHER_BATCH_BITS;
+   const uint64_t mask = uint64_t(1) << (bit % 64);
+   CHECKC(!(bits.bits[bit / 64] & mask), err::RECORD_FOUND, "voucher already redeemed: " + to_string(voucher.nonce));
+   bits.bits[bit / 64] |= mask;
+   _db.set(bits);
+
+   _db.enable_cache();
+
+   auto node = _db.find<node_t>(voucher.node_id);
+   CHECKC(node, err::RECORD_NOT_FOUND, "node not found: " + to_string(voucher.node_id))
+   CHECKC(node->status == NodeStatus::ENABLE, err::PARAM_ERROR, "node not enable: " + to_string(voucher.node_id));
+   CHECKC(node->total_saled + voucher.count <= node->max_sale, err::OVERSIZED, "node saled count exceeded: " + to_string(node->max_sale));
+
+   // queued preorders are served first, like buy and the transfer buy
+   preorder_t::tbl_t preorders(_self, voucher.node_id);
+   CHECKC(preorders.begin() == preorders.end(), err::STATE_MISMATCH, "node preorders pending: " + to_string(voucher.node_id));
+
+   // paid off-chain like addorder, nothing is settled and no commission accrues
+   for (uint64_t i = 0; i < voucher.count; i++) {
+      const asset price = _quote(*node, 1);
+      _db.modify(node, [&](auto& row) { row.total_saled += 1; });
+      _buy(*node, voucher.user, price, EventType::REDEEM);
+   }
 }
 
 /// @brief delete order action only for admin
@@ -353,22 +1573,640 @@ void agpu::delorder(const uint64_t& order_id, const name& user) {
 
    CHECKC(order_id > 0, err::PARAM_ERROR, "invalid order_id" + to_string(order_id));
    CHECKC(is_account(user), err::ACCOUNT_INVALID, "user not found: " + user.to_string());
+   _check_reconcile();
 
    order_t order(order_id);
-   CHECKC(_db.get(user.value, order), err::RECORD_NOT_FOUND, "order not found: " + to_string(order_id))
-
-   _db.del(user.value, order);
+   CHECKC(_del_order(user, order_id, order), err::RECORD_NOT_FOUND, "order not found: " + to_string(order_id))
 
    invite_t invite(user);
    CHECKC(_db.get(invite), err::RECORD_NOT_FOUND, "user invite not found: " + user.to_string());
 
-   uint64_t     node_id = order.node_id;
-   node_total_t node_total(node_id);
-   CHECKC(_db.get(user.value, node_total), err::RECORD_NOT_FOUND, "node total not found: " + to_string(node_id));
+   uint64_t holding = _add_node_total(user, order.node_id, -1);
+   _add_team_orders(user, -1);
+   _add_inviter_sale(order, -1);
+   _add_stat(order.node_id, 0, 1, 0);
+   _log_order(EventType::DELORDER, order, nullopt, holding, nullopt);
+}
+
+/// @brief add count to a holding of the user portfolio
+/// the first update of a user folds its nodetotals rows into the new portfolio and frees them
+/// @param user - user account name
+/// @param node_id - node id
+/// @param count - bought (positive) or removed (negative) count
+/// @return user total of the node after the update
+uint64_t agpu::_add_portfolio(const name& user, const uint64_t& node_id, const int64_t& count) {
+   portfolio_t    portfolio(user);
+   const bool     found    = _db.get(portfolio);
+   const uint64_t old_size = found ? pack_size(portfolio) : 0;
+   if (!found) {
+      node_total_t::tbl_t legacy_totals(_self, user.value);
+      for (auto itr = legacy_totals.begin(); itr != legacy_totals.end(); itr = legacy_totals.erase(itr))
+         portfolio.holdings.push_back({ itr->node_id, itr->total });
+
+      node_total_v2_t::tbl_t totals(_self, user.value);
+      for (auto itr = totals.begin(); itr != totals.end(); itr = totals.erase(itr)) {
+         portfolio.holdings.push_back({ itr->node_id, itr->total });
+         _account_ram(itr->ram_payer.value_or(_self), -1, -int64_t(pack_size(*itr)));
+      }
+   }
+
+   auto itr = find_if(portfolio.holdings.begin(), portfolio.holdings.end(),
+                      [&](const holding_t& holding) { return holding.node_id.value == node_id; });
+   if (itr == portfolio.holdings.end()) {
+      CHECKC(count > 0, err::RECORD_NOT_FOUND, "node total not found: " + to_string(node_id));
+      itr = portfolio.holdings.insert(itr, { node_id, 0 });
+   }
+
+   itr->total += count;
+   uint64_t total = itr->total;
+   if (total == 0)
+      portfolio.holdings.erase(itr);
+
+   // the row grows, so it is billed to the payer of this action: a user paid row moves back to the contract
+   // on updates the user did not sign, e.g. transfer buys, addorder and allocate
+   const name payer     = _ram_payer(user);
+   const name old_payer = portfolio.ram_payer.value_or(_self);
+   if (payer != _self)
+      portfolio.ram_payer.emplace(payer);
+   else
+      portfolio.ram_payer.reset();
+
+   if (portfolio.holdings.empty()) {
+      _db.del(portfolio);
+      if (found)
+         _account_ram(old_payer, -1, -int64_t(old_size));
+   } else if (found && old_payer != payer) {
+      portfolio.update_time = current_time_point();
+      auto row              = _db.find<portfolio_t>(user.value);
+      _db.modify(row, payer, [&](auto& r) { r = portfolio; });
+      _account_ram(old_payer, -1, -int64_t(old_size));
+      _account_ram(payer, 1, pack_size(portfolio));
+   } else {
+      portfolio.update_time = current_time_point();
+      _db.set(portfolio, payer);
+      _account_ram(payer, found ? 0 : 1, int64_t(pack_size(portfolio)) - int64_t(old_size));
+   }
+   return total;
+}
+
+/// @brief remove a holding from the user portfolio, the row goes with its last holding
+/// @param user - user account name
+/// @param node_id - node id
+bool agpu::_del_portfolio(const name& user, const uint64_t& node_id) {
+   portfolio_t portfolio(user);
+   if (!_db.get(portfolio))
+      return false;
+
+   auto itr = find_if(portfolio.holdings.begin(), portfolio.holdings.end(),
+                      [&](const holding_t& holding) { return holding.node_id.value == node_id; });
+   if (itr == portfolio.holdings.end())
+      return false;
+
+   const name     payer    = portfolio.ram_payer.value_or(_self);
+   const uint64_t old_size = pack_size(portfolio);
+   portfolio.holdings.erase(itr);
+   if (portfolio.holdings.empty()) {
+      _db.del(portfolio);
+      _account_ram(payer, -1, -int64_t(old_size));
+   } else {
+      portfolio.update_time = current_time_point();
+      _db.set(portfolio);
+      _account_ram(payer, 0, int64_t(pack_size(portfolio)) - int64_t(old_size));
+   }
+   return true;
+}
+
+/// @brief add a user and its subtree to the team aggregates of its ancestors, O(team_depth^2)
+/// the subtree below the user is read from its own team row, which holds every level an ancestor can keep
+/// @param user - user account name, its invite row links it to the first ancestor
+/// @param sign - 1 to add the subtree, -1 to remove it
+void agpu::_add_subtree(const name& user, const int64_t& sign) {
+   const uint8_t depth = _conf.team_depth;
+   if (depth == 0)
+      return;
+
+   invite_inviter_t invite;
+   if (!_db.get_projection<invite_t>(_self.value, user.value, invite))
+      return;
+
+   team_t sub(user);
+   _db.get(sub);
+
+   for (uint8_t level = 1; level <= depth && invite.inviter != _gstate.bank; level++) {
+      // an inviter removed by signdel ends the path of its invitees
+      const name member = invite.inviter;
+      if (!_db.get_projection<invite_t>(_self.value, member.value, invite))
+         return;
+
+      team_t team(member);
+      if (!_db.get(team) && sign < 0)
+         continue;
+      if (team.members.size() < depth) {
+         team.members.resize(depth);
+         team.orders.resize(depth);
+      }
+
+      add_clamped(team.members[level - 1], sign);
+      add_clamped(team.orders[level - 1], sign * int64_t(sub.own_orders));
+      for (size_t k = 0; level + k < depth && k < sub.members.size(); k++) {
+         add_clamped(team.members[level + k], sign * int64_t(sub.members[k]));
+         add_clamped(team.orders[level + k], sign * int64_t(sub.orders[k]));
+      }
+      team.update_time = current_time_point();
+      _db.set(team);
+   }
+}
+
+/// @brief add bought (positive) or removed (negative) orders of a user to its team aggregates, O(team_depth)
+/// orders bought before the table existed were never counted, their removal creates no row and stops at zero
+/// @param user - user account name
+/// @param count - order count
+void agpu::_add_team_orders(const name& user, const int64_t& count) {
+   const uint8_t depth = _conf.team_depth;
+   if (depth == 0)
+      return;
+
+   invite_inviter_t invite;
+   if (!_db.get_projection<invite_t>(_self.value, user.value, invite))
+      return;
+
+   team_t own(user);
+   if (_db.get(own) || count > 0) {
+      add_clamped(own.own_orders, count);
+      own.update_time = current_time_point();
+      _db.set(own);
+   }
+
+   for (uint8_t level = 1; level <= depth && invite.inviter != _gstate.bank; level++) {
+      // an inviter removed by signdel ends the path of its invitees
+      const name member = invite.inviter;
+      if (!_db.get_projection<invite_t>(_self.value, member.value, invite))
+         return;
+
+      team_t team(member);
+      if (!_db.get(team) && count < 0)
+         continue;
+      if (team.members.size() < depth) {
+         team.members.resize(depth);
+         team.orders.resize(depth);
+      }
+
+      add_clamped(team.orders[level - 1], count);
+      team.update_time = current_time_point();
+      _db.set(team);
+   }
+}
+
+/// @brief add (sign 1) or remove (sign -1) an order in the sales of its inviter, per node and over every node
+/// archived orders stay counted, they were sold all the same
+/// orders bought before the table existed were never counted, their removal is clamped at zero
+/// @param order - order with the inviter recorded at purchase time
+/// @param sign - 1 for a new order, -1 for an erased one
+void agpu::_add_inviter_sale(const order_t& order, const int64_t& sign) {
+   for (const uint64_t& scope : { order.node_id, uint64_t(0) }) {
+      inviter_sale_t sale(order.inviter);
+      const bool     found = _db.get(scope, sale);
+      if (!found && sign < 0)
+         continue;
+      if (!found)
+         sale.volume = asset(0, order.price.symbol);
+
+      if (sign > 0) {
+         sale.order_count += 1;
+         sale.volume.amount += order.price.amount;
+      } else {
+         sale.order_count -= min(sale.order_count, uint64_t(1));
+         sale.volume.amount -= min(sale.volume.amount, order.price.amount);
+      }
+      if (sale.order_count == 0) {
+         if (found)
+            _db.del(scope, sale);
+         continue;
+      }
+      sale.update_time = current_time_point();
+      _db.set(scope, sale, found);
+   }
+}
+
+/// @brief mirror the invite_count of an inviter into the rank table, inviters without invitees are not ranked
+/// top inviters are the first rows of the byrank index, a rank is the distance from its begin
+/// @param invite - invite row of the inviter after its count changed
+void agpu::_rank_inviter(const invite_t& invite) {
+   invite_rank_t rank(invite.user);
+   const bool    found = _db.get(rank);
+   if (found && rank.invite_count == invite.invite_count)
+      return;
+
+   if (invite.invite_count == 0) {
+      if (found)
+         _db.del(rank);
+      return;
+   }
+
+   rank.invite_count = invite.invite_count;
+   rank.update_time  = current_time_point();
+   _db.set(rank);
+}
+
+/// @brief count events in the current hourly stat of a node and in the one over every node
+/// @param node_id - node id, 0 when the event has no node
+/// @param orders - orders bought
+/// @param deleted - orders deleted
+/// @param signups - users signed up
+void agpu::_add_stat(const uint64_t& node_id, const uint64_t& orders, const uint64_t& deleted, const uint64_t& signups) {
+   const uint32_t now   = current_time_point().sec_since_epoch();
+   const auto     start = time_point_sec(now - now % HOUR_SECONDS);
+
+   for (const uint64_t& scope : { node_id, uint64_t(0) }) {
+      hour_stat_t stat(start);
+      const bool  found = _db.get(scope, stat);
+      stat.orders += orders;
+      stat.deleted += deleted;
+      stat.signups += signups;
+      _db.set(scope, stat, found);
+
+      if (node_id == 0)
+         break;
+   }
+}
+
+/// @brief set how long hourly stats are kept before rollstats folds them into daily ones, only for admin
+/// @param stat_retention - seconds
+void agpu::setretention(const uint32_t& stat_retention) {
+   require_auth(_gstate.admin);
+
+   CHECKC(stat_retention >= DAY_SECONDS, err::PARAM_ERROR, "stat_retention less than a day: " + to_string(stat_retention));
+   _conf.stat_retention = stat_retention;
+   _config.set(_conf, _self);
+}
+
+/// @brief fold expired hourly stats of a scope into daily ones, only for admin
+/// only days that ended before the retention window are rolled, a day is never split between tables
+/// @param node_id - stat scope, node id or 0
+/// @param max_rows - max hourly rows to fold in this call
+void agpu::rollstats(const uint64_t& node_id, const uint32_t& max_rows) {
+   require_auth(_gstate.admin);
+
+   CHECKC(max_rows > 0, err::PARAM_ERROR, "invalid max_rows" + to_string(max_rows));
+
+   const uint32_t cutoff = current_time_point().sec_since_epoch() - _conf.stat_retention;
+   const uint32_t limit  = cutoff - cutoff % DAY_SECONDS;
+
+   hour_stat_t::tbl_t        hours(_self, node_id);
+   map<uint32_t, day_stat_t> days;
+   uint32_t                  rows = 0;
+
+   for (auto itr = hours.begin(); itr != hours.end() && itr->start.sec_since_epoch() < limit && rows < max_rows; rows++) {
+      const uint32_t sec = itr->start.sec_since_epoch();
+      const uint32_t day = sec - sec % DAY_SECONDS;
+
+      auto day_itr = days.find(day);
+      if (day_itr == days.end()) {
+         day_itr = days.emplace(day, day_stat_t(time_point_sec(day))).first;
+         _db.get(node_id, day_itr->second);
+      }
+      day_itr->second.orders += itr->orders;
+      day_itr->second.deleted += itr->deleted;
+      day_itr->second.signups += itr->signups;
+
+      itr = hours.erase(itr);
+   }
+
+   CHECKC(rows > 0, err::RECORD_NOT_FOUND, "no expired hourly stats: " + to_string(node_id));
+
+   for (const auto& [day, stat] : days) {
+      day_stat_t::tbl_t daily(_self, node_id);
+      auto              day_itr = daily.find(day);
+      if (day_itr == daily.end()) {
+         daily.emplace(_self, [&](auto& row) { row = stat; });
+      } else {
+         daily.modify(day_itr, same_payer, [&](auto& row) { row = stat; });
+      }
+   }
+}
+
+/// @brief set how many ancestor levels team aggregates reach, only for admin
+/// aggregates follow the events after the change, existing rows are not recounted
+/// @param team_depth - levels, 0 disables team aggregates
+void agpu::setteamdepth(const uint8_t& team_depth) {
+   require_auth(_gstate.admin);
+
+   CHECKC(team_depth <= MAX_TEAM_DEPTH, err::OVERSIZED, "team depth exceeded: " + to_string(MAX_TEAM_DEPTH));
+   _conf.team_depth = team_depth;
+   _config.set(_conf, _self);
+}
+
+/// @brief payer of a new order or holding row of the user under the ram payer policy
+/// notifications can only bill the contract, so the user pays only in a direct action it signed
+/// @param user - user account name
+name agpu::_ram_payer(const name& user) {
+   if (_conf.ram_payer == RamPayer::USER && get_first_receiver() == _self && has_auth(user))
+      return user;
+   return _self;
+}
+
+/// @brief add created (positive) or erased (negative) rows and resized bytes to the ram account of their payer
+/// the account row is billed to the same payer, it counts itself and goes away with the last row it counts
+/// @param payer - account billed for the rows
+/// @param rows - row count
+/// @param bytes - packed size of the rows
+void agpu::_account_ram(const name& payer, const int64_t& rows, const int64_t& bytes) {
+   if (rows == 0 && bytes == 0)
+      return;
+
+   ram_payer_t account(payer);
+   if (!_db.get(account)) {
+      account.rows  = 1;
+      account.bytes = pack_size(account) + ROW_RAM_OVERHEAD;
+   }
+
+   account.rows += rows;
+   account.bytes += bytes + rows * int64_t(ROW_RAM_OVERHEAD);
+   if (account.rows == 1) {
+      _db.del(account);
+      return;
+   }
+   _db.set(account, payer);
+}
+
+/// @brief set the payer policy of order and holding rows, only for admin
+/// @param ram_payer - RamPayer::SELF or RamPayer::USER
+void agpu::setrampayer(const name& ram_payer) {
+   require_auth(_gstate.admin);
+
+   CHECKC(ram_payer == RamPayer::SELF || ram_payer == RamPayer::USER, err::PARAM_ERROR, "invalid ram_payer: " + ram_payer.to_string());
+   _conf.ram_payer = ram_payer;
+   _config.set(_conf, _self);
+}
+
+/// @brief keep holdings in the portfolios table from now on, only for admin
+/// users are moved over on their next holding update, there is no way back
+void agpu::useportfolio() {
+   require_auth(_gstate.admin);
+
+   CHECKC(!_conf.portfolio, err::STATE_MISMATCH, "portfolio already in use");
+   _conf.portfolio = true;
+   _config.set(_conf, _self);
+}
+
+/// @brief shard config of this contract, read once per action
+const shard_conf_t& agpu::_shard_conf() {
+   if (!_shard) {
+      shard_conf_singleton conf(_self, _self.value);
+      _shard = conf.get_or_default();
+   }
+   return *_shard;
+}
+
+/// @brief refuse node changes on a shard, its nodes are synced from the coordinator by grant
+void agpu::_check_not_shard() {
+   const auto& conf = _shard_conf();
+   CHECKC(!conf.coordinator || conf.coordinator == _self, err::STATE_MISMATCH, "shard nodes are synced by the coordinator");
+}
+
+/// @brief whether a user is served by this contract
+/// every user is local to an unsharded contract, none to a coordinator
+/// @param user - user account name
+bool agpu::_is_local(const name& user) {
+   const auto& shards = _shard_conf().shards;
+   if (shards.empty())
+      return true;
+   return shards[shard_index(user, shards.size())] == _self;
+}
+
+/// @brief check that an inviter served by another shard is signed up there
+/// its invite_count only counts invitees of its own shard, this shard can not write it
+/// @param inviter - inviter account name
+void agpu::_check_remote_inviter(const name& inviter) {
+   const auto&     shards = _shard_conf().shards;
+   const name      shard  = shards[shard_index(inviter, shards.size())];
+   invite_t::tbl_t invites(shard, shard.value);
+   CHECKC(invites.find(inviter.value) != invites.end(), err::RECORD_NOT_FOUND, "inviter not exist: " + inviter.to_string());
+}
+
+/// @brief make this contract the coordinator of the given shards, only for admin
+/// users are routed by shard_index over this list, so it can only be set once
+/// @param shards - shard accounts running this contract, in routing order
+void agpu::setshards(const vector<name>& shards) {
+   require_auth(_gstate.admin);
+
+   shard_conf_singleton conf(_self, _self.value);
+   shard_conf_t         state = conf.get_or_default();
+   CHECKC(!state.coordinator, err::STATE_MISMATCH, "already sharded: " + state.coordinator.to_string());
+
+   // users of the coordinator would no longer be local, their orders and balances stranded
+   invite_t::tbl_t invites(_self, _self.value);
+   CHECKC(invites.begin() == invites.end(), err::STATE_MISMATCH, "coordinator already has users");
+   CHECKC(shards.size() >= 2 && shards.size() <= MAX_SHARDS, err::PARAM_ERROR, "invalid shard count" + to_string(shards.size()));
+
+   set<name> seen;
+   for (const auto& shard : shards) {
+      CHECKC(is_account(shard), err::ACCOUNT_INVALID, "shard not found: " + shard.to_string());
+      CHECKC(shard != _self, err::PARAM_ERROR, "coordinator can not be a shard");
+      CHECKC(seen.insert(shard).second, err::PARAM_ERROR, "duplicate shard: " + shard.to_string());
+   }
+
+   state.coordinator = _self;
+   state.shards      = shards;
+   conf.set(state, _self);
+}
+
+/// @brief join a coordinator as one of its shards, only for admin
+/// the shard list is copied from the coordinator, a shard joins before it has users,
+/// users routed to another shard would be stranded with their orders
+/// @param coordinator - coordinator account
+void agpu::setcoord(const name& coordinator) {
+   require_auth(_gstate.admin);
+
+   shard_conf_singleton conf(_self, _self.value);
+   shard_conf_t         state = conf.get_or_default();
+   CHECKC(!state.coordinator, err::STATE_MISMATCH, "already sharded: " + state.coordinator.to_string());
+
+   invite_t::tbl_t invites(_self, _self.value);
+   CHECKC(invites.begin() == invites.end(), err::STATE_MISMATCH, "shard already has users");
+
+   shard_conf_singleton remote(coordinator, coordinator.value);
+   CHECKC(remote.exists(), err::RECORD_NOT_FOUND, "coordinator not sharded: " + coordinator.to_string());
+   const shard_conf_t remote_state = remote.get();
+   CHECKC(remote_state.coordinator == coordinator, err::STATE_MISMATCH, "not a coordinator: " + coordinator.to_string());
+   CHECKC(find(remote_state.shards.begin(), remote_state.shards.end(), _self) != remote_state.shards.end(), err::NO_AUTH,
+          "not a shard of " + coordinator.to_string());
+
+   state.coordinator = coordinator;
+   state.shards      = remote_state.shards;
+   conf.set(state, _self);
+}
+
+/// @brief grant a shard its quota of a node, the node is synced to the shard with max_sale set to the quota
+/// granting again pushes price, status and start_time changes of the node
+/// @param node_id - node id on the coordinator
+/// @param shard - shard account
+/// @param quota - units the shard may sell
+void agpu::grant(const uint64_t& node_id, const name& shard, const uint64_t& quota) {
+   require_auth(_gstate.admin);
+
+   const auto& conf = _shard_conf();
+   CHECKC(conf.coordinator == _self, err::STATE_MISMATCH, "not a coordinator");
+   CHECKC(find(conf.shards.begin(), conf.shards.end(), shard) != conf.shards.end(), err::PARAM_ERROR,
+          "unknown shard: " + shard.to_string());
+
+   auto node = _db.find<node_t>(node_id);
+   CHECKC(node, err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id));
+
+   // each shard would walk the curve from its own total_saled, a priced node is sold by the coordinator only
+   pricing_t pricing(node_id);
+   CHECKC(!_db.get(pricing), err::STATE_MISMATCH, "priced node can not be granted: " + to_string(node_id));
+
+   uint64_t             granted = 0;
+   shard_quota_t::tbl_t quotas(_self, node_id);
+   for (auto itr = quotas.begin(); itr != quotas.end(); itr++) {
+      if (itr->shard != shard)
+         granted += itr->quota;
+   }
+   CHECKC(granted + quota <= node->max_sale, err::OVERSIZED, "node quota exceeded: " + to_string(node->max_sale));
+
+   _sync_quota(*node, shard, quota);
+}
+
+/// @brief move unsold quota of a node from one shard to another
+/// @param node_id - node id on the coordinator
+/// @param from - shard giving up quota
+/// @param to - shard receiving it
+/// @param units - moved units
+void agpu::rebalance(const uint64_t& node_id, const name& from, const name& to, const uint64_t& units) {
+   require_auth(_gstate.admin);
+
+   const auto& conf = _shard_conf();
+   CHECKC(conf.coordinator == _self, err::STATE_MISMATCH, "not a coordinator");
+   CHECKC(from != to, err::PARAM_ERROR, "from and to is same");
+   CHECKC(units > 0, err::NOT_POSITIVE, "invalid units" + to_string(units));
+   CHECKC(find(conf.shards.begin(), conf.shards.end(), to) != conf.shards.end(), err::PARAM_ERROR,
+          "unknown shard: " + to.to_string());
+
+   auto node = _db.find<node_t>(node_id);
+   CHECKC(node, err::RECORD_NOT_FOUND, "node not found: " + to_string(node_id));
+
+   shard_quota_t source(from);
+   CHECKC(_db.get(node_id, source), err::RECORD_NOT_FOUND, "no quota granted to " + from.to_string());
+
+   // sales are read from the shard's own node row, its syncnode checks them again
+   node_t::tbl_t remote(from, from.value);
+   auto          remote_itr = remote.find(node_id);
+   uint64_t      saled      = remote_itr == remote.end() ? 0 : remote_itr->total_saled;
+   CHECKC(source.quota >= saled + units, err::OVERSIZED, "unsold quota of " + from.to_string() + ": " + to_string(source.quota - saled));
+
+   shard_quota_t target(to);
+   _db.get(node_id, target);
+
+   _sync_quota(*node, from, source.quota - units);
+   _sync_quota(*node, to, target.quota + units);
+}
+
+/// @brief record the quota of a shard and sync the node to it
+void agpu::_sync_quota(const node_t& node, const name& shard, const uint64_t& quota) {
+   shard_quota_t row(shard);
+   const bool    found = _db.get(node.node_id, row);
+   row.quota           = quota;
+   _db.set(node.node_id, row, found);
+
+   node_t synced   = node;
+   synced.max_sale = quota;
+   syncnode_action act{ shard, { { _self, active_perm } } };
+   act.send(synced);
+}
+
+/// @brief node pushed by the coordinator, only for the coordinator
+/// max_sale is the quota of this shard, total_saled stays the shard's own
+/// @param node - coordinator node with max_sale set to the quota
+void agpu::syncnode(const node_t& node) {
+   const auto& conf = _shard_conf();
+   CHECKC(conf.coordinator && conf.coordinator != _self, err::STATE_MISMATCH, "not a shard");
+   require_auth(conf.coordinator);
+
+   auto row = _db.find<node_t>(node.node_id);
+   if (row) {
+      CHECKC(node.max_sale >= row->total_saled, err::OVERSIZED, "quota below saled count: " + to_string(row->total_saled));
+      _db.modify(row, [&](auto& r) {
+         r.price       = node.price;
+         r.max_sale    = node.max_sale;
+         r.status      = node.status;
+         r.start_time  = node.start_time;
+         r.update_time = current_time_point();
+      });
+      _log_node(EventType::SETNODE, *row);
+      return;
+   }
+
+   node_t added      = node;
+   added.total_saled = 0;
+   added.create_time = current_time_point();
+   added.update_time = current_time_point();
+   _db.insert(_self.value, added);
+   _log_node(EventType::ADDNODE, added);
+}
+
+/// @brief turn the event log on or off, only for admin
+/// @param event_log - emit nodelog, invitelog and orderlog actions
+void agpu::setlog(const bool& event_log) {
+   require_auth(_gstate.admin);
+
+   _conf.event_log = event_log;
+   _config.set(_conf, _self);
+}
+
+/// @brief node event, sent inline by the contract itself
+/// @param version - payload version, EVENT_VERSION
+/// @param event - event type
+/// @param node - node row after the event
+void agpu::nodelog(const uint8_t& version, const name& event, const node_t& node) {
+   require_auth(_self);
+}
+
+/// @brief invite event, sent inline by the contract itself
+/// @param version - payload version, EVENT_VERSION
+/// @param event - event type
+/// @param invite - invite row after the event
+void agpu::invitelog(const uint8_t& version, const name& event, const invite_t& invite) {
+   require_auth(_self);
+}
+
+/// @brief order event, sent inline by the contract itself
+/// @param version - payload version, EVENT_VERSION
+/// @param event - event type
+/// @param log - order and the counters it changed
+void agpu::orderlog(const uint8_t& version, const name& event, const order_log_t& log) {
+   require_auth(_self);
+}
+
+void agpu::_log_node(const name& event, const node_t& node) {
+   if (!_conf.event_log)
+      return;
+
+   nodelog_action act{ _self, { { _self, active_perm } } };
+   act.send(EVENT_VERSION, event, node);
+}
+
+void agpu::_log_invite(const name& event, const invite_t& invite) {
+   if (!_conf.event_log)
+      return;
+
+   invitelog_action act{ _self, { { _self, active_perm } } };
+   act.send(EVENT_VERSION, event, invite);
+}
+
+void agpu::_log_order(const name& event, const order_t& order, const optional<uint64_t>& total_saled, const optional<uint64_t>& holding,
+                      const optional<uint64_t>& leaf_index) {
+   if (!_conf.event_log)
+      return;
+
+   order_log_t log;
+   log.order       = order;
+   log.total_saled = total_saled;
+   log.holding     = holding;
+   log.leaf_index  = leaf_index;
 
-   node_total.total -= 1;
-   node_total.update_time = current_time_point();
-   _db.set(user.value, node_total, true);
+   orderlog_action act{ _self, { { _self, active_perm } } };
+   act.send(EVENT_VERSION, event, log);
 }
 
 } // namespace amax
\ No newline at end of file
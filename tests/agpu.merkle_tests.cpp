@@ -0,0 +1,178 @@
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+
+#include "agpu_tester.hpp"
+
+// mirror of wasm::merkle, hashes are compared as bytes like checksum256
+static fc::sha256 hash_pair(const fc::sha256& left, const fc::sha256& right) {
+   char data[64];
+   memcpy(data, left.data(), 32);
+   memcpy(data + 32, right.data(), 32);
+   return fc::sha256::hash(data, sizeof(data));
+}
+
+static fc::sha256 hash_sorted(const fc::sha256& a, const fc::sha256& b) {
+   return memcmp(a.data(), b.data(), 32) < 0 ? hash_pair(a, b) : hash_pair(b, a);
+}
+
+// root of the perfect tree over leaves [from, from + size)
+static fc::sha256 tree_root(const vector<fc::sha256>& leaves, const uint64_t& from, const uint64_t& size) {
+   if (size == 1)
+      return leaves[from];
+   return hash_pair(tree_root(leaves, from, size / 2), tree_root(leaves, from + size / 2, size / 2));
+}
+
+// siblings of leaf index up to the peak of its perfect tree among the first count leaves, lowest first
+static vector<fc::sha256> mmr_proof(const vector<fc::sha256>& leaves, const uint64_t& count, const uint64_t& index) {
+   uint64_t offset = 0;
+   uint64_t size   = 0;
+   for (int height = 63; height >= 0; height--) {
+      size = uint64_t(1) << height;
+      if (!(count & size))
+         continue;
+      if (index < offset + size)
+         break;
+      offset += size;
+   }
+
+   vector<fc::sha256> proof;
+   for (uint64_t width = 1; width < size; width <<= 1) {
+      const uint64_t sibling = ((index - offset) / width) ^ 1;
+      proof.push_back(tree_root(leaves, offset + sibling * width, width));
+   }
+   return proof;
+}
+
+// peaks tallest first, bagged from the shortest one up
+static fc::sha256 mmr_root(const vector<fc::sha256>& leaves, const uint64_t& count) {
+   vector<fc::sha256> peaks;
+   uint64_t           offset = 0;
+   for (int height = 63; height >= 0; height--) {
+      const uint64_t size = uint64_t(1) << height;
+      if (!(count & size))
+         continue;
+      peaks.push_back(tree_root(leaves, offset, size));
+      offset += size;
+   }
+
+   fc::sha256 root = peaks.back();
+   for (auto itr = peaks.rbegin() + 1; itr != peaks.rend(); itr++)
+      root = hash_pair(*itr, root);
+   return root;
+}
+
+class agpu_merkle_tester : public agpu_tester {
+ public:
+   agpu_merkle_tester() {
+      // orderlog is sent inline by the contract
+      set_authority(agpu, config::active_name,
+                    authority(1, { key_weight{ get_public_key(agpu, "active"), 1 } },
+                              { permission_level_weight{ { agpu, config::eosio_code_name }, 1 } }),
+                    config::owner_name);
+
+      BOOST_REQUIRE_EQUAL(success(), push_action(admin, "setlog"_n, mvo()("event_log", true)));
+      BOOST_REQUIRE_EQUAL(success(), push_action(admin, "setarchive"_n, mvo()("archive_delay", 1)));
+      BOOST_REQUIRE_EQUAL(success(), addnode(100));
+      BOOST_REQUIRE_EQUAL(success(), signup("alice"_n));
+      BOOST_REQUIRE_EQUAL(success(), signup("bob"_n));
+      produce_blocks();
+   }
+
+   // archive every settled order, the ARCHIVE orderlog events give each order its leaf index
+   void archive() {
+      produce_block(fc::seconds(3));
+      auto trace = base_tester::push_action(agpu, "archive"_n, admin, mvo()("max_rows", 100));
+      for (const auto& at : trace->action_traces) {
+         if (at.receiver != agpu || at.act.name != "orderlog"_n)
+            continue;
+
+         auto event = abi_ser.binary_to_variant("orderlog", at.act.data, abi_serializer::create_yield_function(abi_serializer_max_time));
+         if (event["event"].as<name>() != "archive"_n)
+            continue;
+
+         const auto& log   = event["log"];
+         const auto  index = log["leaf_index"].as<uint64_t>();
+         const auto  data  = abi_ser.variant_to_binary("order_t", log["order"], abi_serializer::create_yield_function(abi_serializer_max_time));
+         if (orders.size() <= index) {
+            orders.resize(index + 1);
+            leaves.resize(index + 1);
+         }
+         orders[index] = log["order"];
+         leaves[index] = fc::sha256::hash(data.data(), data.size());
+      }
+      produce_blocks();
+   }
+
+   action_result verifyorder(const uint64_t& index, const fc::variant& order, const vector<fc::sha256>& proof) {
+      return push_action(admin, "verifyorder"_n, mvo()("index", index)("order", order)("proof", proof));
+   }
+
+   vector<fc::variant> orders;
+   vector<fc::sha256>  leaves;
+};
+
+BOOST_AUTO_TEST_SUITE(agpu_merkle_tests)
+
+BOOST_FIXTURE_TEST_CASE(accumulator_proofs, agpu_merkle_tester) try {
+   uint64_t count = 0;
+   for (const uint64_t batch : { 1, 2, 1, 3, 1 }) {
+      for (uint64_t i = 0; i < batch; i++)
+         BOOST_REQUIRE_EQUAL(success(), addorder(1, i % 2 ? "bob"_n : "alice"_n));
+      archive();
+      count += batch;
+
+      BOOST_REQUIRE_EQUAL(count, leaves.size());
+      auto acc = get_row("orderaccs"_n, name(1), "order_acc_t");
+      BOOST_REQUIRE_EQUAL(count, acc["leaf_count"].as<uint64_t>());
+      BOOST_REQUIRE_EQUAL(mmr_root(leaves, count).str(), acc["root"].as_string());
+
+      for (uint64_t index = 0; index < count; index++) {
+         const auto proof = mmr_proof(leaves, count, index);
+         BOOST_REQUIRE_EQUAL(success(), verifyorder(index, orders[index], proof));
+         if (count > 1)
+            BOOST_REQUIRE(failed_with(verifyorder((index + 1) % count, orders[index], proof), "invalid proof"));
+      }
+   }
+
+   auto forged     = mvo(orders[0].get_object());
+   forged["price"] = "11.000000 MUSDT";
+   BOOST_REQUIRE(failed_with(verifyorder(0, forged, mmr_proof(leaves, count, 0)), "invalid proof"));
+   BOOST_REQUIRE(failed_with(verifyorder(count, orders[0], {}), "invalid index"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(allowlist_proofs, agpu_merkle_tester) try {
+   const vector<pair<name, uint64_t>> entries = { { "alice"_n, 2 }, { "bob"_n, 3 }, { "carol"_n, 1 } };
+
+   vector<fc::sha256> leaves;
+   for (const auto& [account, cap] : entries) {
+      auto data = fc::raw::pack(account);
+      auto tail = fc::raw::pack(cap);
+      data.insert(data.end(), tail.begin(), tail.end());
+      leaves.push_back(fc::sha256::hash(data.data(), data.size()));
+   }
+   const fc::sha256                 pair01 = hash_sorted(leaves[0], leaves[1]);
+   const fc::sha256                 root   = hash_sorted(pair01, leaves[2]);
+   const vector<vector<fc::sha256>> proofs = { { leaves[1], leaves[2] }, { leaves[0], leaves[2] }, { pair01 } };
+
+   const uint32_t start_time = (control->head_block_time() + fc::seconds(60)).sec_since_epoch();
+   BOOST_REQUIRE_EQUAL(success(), push_action(admin, "setnode"_n,
+                                              mvo()("node_id", 1)("price", "10.000000 MUSDT")("max_sale", 100)("start_time", start_time)(
+                                                    "allowlist_root", root)));
+
+   auto prove = [&](const name& user, const uint64_t& cap, const vector<fc::sha256>& proof) {
+      return push_action(user, "prove"_n, mvo()("user", user)("node_id", 1)("cap", cap)("proof", proof));
+   };
+
+   BOOST_REQUIRE(failed_with(prove("alice"_n, 3, proofs[0]), "invalid allowlist proof"));
+   BOOST_REQUIRE(failed_with(prove("alice"_n, 2, proofs[1]), "invalid allowlist proof"));
+   for (size_t i = 0; i < entries.size(); i++)
+      BOOST_REQUIRE_EQUAL(success(), prove(entries[i].first, entries[i].second, proofs[i]));
+
+   produce_blocks();
+   BOOST_REQUIRE(failed_with(prove("bob"_n, 3, proofs[1]), "allowlist entry already proved"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,57 @@
+#include <boost/test/unit_test.hpp>
+
+#include "agpu_tester.hpp"
+
+class agpu_portfolio_tester : public agpu_tester {
+ public:
+   const name alice = "alice"_n;
+
+   agpu_portfolio_tester() {
+      BOOST_REQUIRE_EQUAL(success(), push_action(admin, "setrampayer"_n, mvo()("ram_payer", "user")));
+      BOOST_REQUIRE_EQUAL(success(), push_action(admin, "useportfolio"_n, mvo()));
+      BOOST_REQUIRE_EQUAL(success(), push_action(admin, "setvoucher"_n,
+                                                 mvo()("voucher_key", get_public_key(admin, "active"))("voucher_chain", control->get_chain_id())));
+      produce_blocks();
+   }
+
+   // the user signs the redeem, so the rows it creates are billed to the user
+   action_result redeem(const name& user, const uint64_t& node_id, const uint64_t& nonce) {
+      auto voucher = mvo()("chain_id", control->get_chain_id())("contract", agpu)("node_id", node_id)("user", user)("count", 1)(
+            "nonce", nonce)("expiry", (control->head_block_time() + fc::seconds(600)).sec_since_epoch());
+
+      const auto data = abi_ser.variant_to_binary("voucher_t", voucher, abi_serializer::create_yield_function(abi_serializer_max_time));
+      const auto sig  = get_private_key(admin, "active").sign(fc::sha256::hash(data.data(), data.size()));
+      return push_action(user, "redeem"_n, mvo()("voucher", voucher)("sig", sig));
+   }
+};
+
+BOOST_AUTO_TEST_SUITE(agpu_portfolio_tests)
+
+// addorder is signed by the admin alone, like the transfer notification and allocate it can not bill the user
+BOOST_FIXTURE_TEST_CASE(unsigned_growth_moves_payer, agpu_portfolio_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), addnode(100));
+   BOOST_REQUIRE_EQUAL(success(), addnode(100));
+   BOOST_REQUIRE_EQUAL(success(), signup(alice));
+
+   BOOST_REQUIRE_EQUAL(success(), redeem(alice, 1, 1));
+   auto portfolio = get_row("portfolios"_n, alice, "portfolio_t");
+   BOOST_REQUIRE_EQUAL(alice, portfolio["ram_payer"].as<name>());
+   BOOST_REQUIRE_EQUAL(3u, get_row("rampayers"_n, alice, "ram_payer_t")["rows"].as<uint64_t>());
+
+   // a second holding grows the row
+   BOOST_REQUIRE_EQUAL(success(), addorder(2, alice));
+   portfolio = get_row("portfolios"_n, alice, "portfolio_t");
+   BOOST_REQUIRE_EQUAL(2u, portfolio["holdings"].get_array().size());
+   BOOST_REQUIRE(!portfolio.get_object().contains("ram_payer"));
+   BOOST_REQUIRE_EQUAL(2u, get_row("rampayers"_n, alice, "ram_payer_t")["rows"].as<uint64_t>());
+   BOOST_REQUIRE_EQUAL(3u, get_row("rampayers"_n, agpu, "ram_payer_t")["rows"].as<uint64_t>());
+
+   // a signed update bills the user again
+   BOOST_REQUIRE_EQUAL(success(), redeem(alice, 2, 2));
+   BOOST_REQUIRE_EQUAL(alice, get_row("portfolios"_n, alice, "portfolio_t")["ram_payer"].as<name>());
+   BOOST_REQUIRE_EQUAL(4u, get_row("rampayers"_n, alice, "ram_payer_t")["rows"].as<uint64_t>());
+   BOOST_REQUIRE_EQUAL(2u, get_row("rampayers"_n, agpu, "ram_payer_t")["rows"].as<uint64_t>());
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
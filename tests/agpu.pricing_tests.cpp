@@ -0,0 +1,91 @@
+#include <boost/test/unit_test.hpp>
+
+#include "agpu_tester.hpp"
+
+class agpu_pricing_tester : public agpu_tester {
+ public:
+   agpu_pricing_tester() {
+      BOOST_REQUIRE_EQUAL(success(), signup("alice"_n));
+      produce_blocks();
+   }
+
+   static string musdt(const int64_t& amount) {
+      return asset(amount, symbol(6, "MUSDT")).to_string();
+   }
+
+   action_result setpricing(const uint64_t& node_id, const name& curve, const int64_t& base, const int64_t& step, const uint32_t& rate,
+                            const vector<variant>& tiers = {}) {
+      return push_action(admin, "setpricing"_n,
+                         mvo()("node_id", node_id)("curve", curve)("base", base)("step", step)("rate", rate)("tiers", tiers));
+   }
+
+   // addorder only takes the exact quote of the next unit, which the closed form total telescopes to
+   void check_units(const uint64_t& node_id, const vector<int64_t>& units) {
+      for (size_t k = 0; k < units.size(); k++) {
+         BOOST_TEST_CONTEXT("node " << node_id << " unit " << k) {
+            BOOST_REQUIRE(failed_with(addorder(node_id, "alice"_n, musdt(units[k] + 1)), "invalid quantity"));
+            BOOST_REQUIRE(failed_with(addorder(node_id, "alice"_n, musdt(units[k] - 1)), "invalid quantity"));
+            BOOST_REQUIRE_EQUAL(success(), addorder(node_id, "alice"_n, musdt(units[k])));
+         }
+      }
+      BOOST_REQUIRE_EQUAL(units.size(), get_node(node_id)["total_saled"].as<uint64_t>());
+   }
+};
+
+BOOST_AUTO_TEST_SUITE(agpu_pricing_tests)
+
+BOOST_FIXTURE_TEST_CASE(linear_units, agpu_pricing_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), addnode(8));
+   BOOST_REQUIRE_EQUAL(success(), setpricing(1, "linear"_n, 10000000, 500000, 0));
+
+   vector<int64_t> units;
+   for (int64_t k = 0; k < 8; k++)
+      units.push_back(10000000 + 500000 * k);
+   check_units(1, units);
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(exponential_units, agpu_pricing_tester) try {
+   // growth factors of 2 and 1.5 keep every unit price exact in the fixed point scale
+   BOOST_REQUIRE_EQUAL(success(), addnode(8));
+   BOOST_REQUIRE_EQUAL(success(), setpricing(1, "exponential"_n, 1000000, 0, 10000));
+   BOOST_REQUIRE_EQUAL(success(), addnode(8));
+   BOOST_REQUIRE_EQUAL(success(), setpricing(2, "exponential"_n, 8000000, 0, 5000));
+
+   vector<int64_t> doubling;
+   vector<int64_t> growing;
+   int64_t         pow2 = 1;
+   int64_t         pow3 = 1;
+   for (int64_t k = 0; k < 8; k++, pow2 *= 2, pow3 *= 3) {
+      doubling.push_back(1000000 * pow2);
+      growing.push_back(8000000 * pow3 / pow2);
+   }
+   check_units(1, doubling);
+   check_units(2, growing);
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(tier_units, agpu_pricing_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), addnode(8));
+
+   auto tier = [](const uint64_t& from_saled, const int64_t& amount) { return variant(mvo()("from_saled", from_saled)("amount", amount)); };
+   BOOST_REQUIRE(failed_with(setpricing(1, "tiers"_n, 0, 0, 0, { tier(1, 10000000) }), "first tier must start at 0"));
+   BOOST_REQUIRE(failed_with(setpricing(1, "tiers"_n, 0, 0, 0, { tier(0, 10000000), tier(0, 15000000) }), "tiers must ascend"));
+   BOOST_REQUIRE_EQUAL(success(), setpricing(1, "tiers"_n, 0, 0, 0, { tier(0, 10000000), tier(3, 15000000), tier(5, 20000000) }));
+
+   check_units(1, { 10000000, 10000000, 10000000, 15000000, 15000000, 20000000, 20000000, 20000000 });
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(fixed_restores_node_price, agpu_pricing_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), addnode(8));
+   BOOST_REQUIRE(failed_with(setpricing(1, "fixed"_n, 0, 0, 0), "node pricing not found"));
+   BOOST_REQUIRE_EQUAL(success(), setpricing(1, "linear"_n, 20000000, 1000000, 0));
+   check_units(1, { 20000000, 21000000 });
+
+   BOOST_REQUIRE_EQUAL(success(), setpricing(1, "fixed"_n, 0, 0, 0));
+   BOOST_REQUIRE_EQUAL(success(), addorder(1, "alice"_n));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
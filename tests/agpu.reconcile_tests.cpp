@@ -0,0 +1,96 @@
+#include <boost/test/unit_test.hpp>
+
+#include "agpu_tester.hpp"
+
+class agpu_reconcile_tester : public agpu_tester {
+ public:
+   agpu_reconcile_tester() {
+      BOOST_REQUIRE_EQUAL(success(), addnode(100));
+      BOOST_REQUIRE_EQUAL(success(), addnode(100));
+      BOOST_REQUIRE_EQUAL(success(), signup("alice"_n));
+      BOOST_REQUIRE_EQUAL(success(), signup("bob"_n));
+      for (const auto& user : { "alice"_n, "bob"_n, "alice"_n })
+         BOOST_REQUIRE_EQUAL(success(), addorder(1, user));
+      BOOST_REQUIRE_EQUAL(success(), addorder(2, "bob"_n));
+   }
+
+   fc::variant get_state() {
+      return get_row("reconcile"_n, "reconcile"_n, "reconcile_t");
+   }
+
+   fc::variant get_tally(const name& scope, const uint64_t& id) {
+      vector<char> data = get_row_by_account(agpu, scope, "recontally"_n, name(id));
+      return data.empty() ? fc::variant()
+                          : abi_ser.binary_to_variant("recon_tally_t", data, abi_serializer::create_yield_function(abi_serializer_max_time));
+   }
+
+   // small steps, so every phase is resumed from its cursor at least once
+   void finish() {
+      for (int steps = 0; get_state()["phase"].as<name>() != "done"_n; steps++) {
+         BOOST_REQUIRE(steps < 100);
+         produce_blocks();
+         BOOST_REQUIRE_EQUAL(success(), push_action(admin, "recstep"_n, mvo()("max_rows", 2)));
+      }
+      produce_blocks();
+   }
+
+   void run(const bool& apply) {
+      BOOST_REQUIRE_EQUAL(success(), push_action(admin, "recbegin"_n, mvo()("apply", apply)));
+      finish();
+   }
+
+   action_result settotalsale(const uint64_t& node_id, const uint64_t& total_saled) {
+      return push_action(admin, "settotalsale"_n, mvo()("node_id", node_id)("total_saled", total_saled));
+   }
+};
+
+BOOST_AUTO_TEST_SUITE(agpu_reconcile_tests)
+
+BOOST_FIXTURE_TEST_CASE(matching_counters, agpu_reconcile_tester) try {
+   run(true);
+
+   BOOST_REQUIRE_EQUAL(0u, get_state()["node_diffs"].as<uint64_t>());
+   BOOST_REQUIRE(get_tally("node"_n, 1).is_null());
+   BOOST_REQUIRE(get_tally("node"_n, 2).is_null());
+   BOOST_REQUIRE_EQUAL(3u, get_node(1)["total_saled"].as<uint64_t>());
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(dry_run_reports, agpu_reconcile_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), settotalsale(1, 5));
+   run(false);
+
+   BOOST_REQUIRE_EQUAL(1u, get_state()["node_diffs"].as<uint64_t>());
+   auto tally = get_tally("node"_n, 1);
+   BOOST_REQUIRE_EQUAL(3u, tally["counted"].as<uint64_t>());
+   BOOST_REQUIRE_EQUAL(5u, tally["recorded"].as<uint64_t>());
+   BOOST_REQUIRE_EQUAL(5u, get_node(1)["total_saled"].as<uint64_t>());
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(apply_blocks_writers, agpu_reconcile_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), settotalsale(1, 5));
+   BOOST_REQUIRE_EQUAL(success(), push_action(admin, "recbegin"_n, mvo()("apply", true)));
+
+   BOOST_REQUIRE(failed_with(settotalsale(1, 3), "reconcile in progress"));
+   BOOST_REQUIRE(failed_with(addorder(1, "alice"_n), "reconcile in progress"));
+   BOOST_REQUIRE(failed_with(signup("carol"_n), "reconcile in progress"));
+
+   finish();
+   BOOST_REQUIRE_EQUAL(3u, get_node(1)["total_saled"].as<uint64_t>());
+   BOOST_REQUIRE_EQUAL(success(), settotalsale(1, 4));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(deleted_nodes_are_not_tallied, agpu_reconcile_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), push_action(admin, "setnodestate"_n, mvo()("node_id", 2)("status", "disable")));
+   BOOST_REQUIRE_EQUAL(success(), push_action(admin, "delnode"_n, mvo()("node_id", 2)));
+   run(false);
+
+   // the order of node 2 waits for gcnode, nothing compares it any more
+   BOOST_REQUIRE_EQUAL(0u, get_state()["node_diffs"].as<uint64_t>());
+   BOOST_REQUIRE(get_tally("node"_n, 2).is_null());
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
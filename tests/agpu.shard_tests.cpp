@@ -0,0 +1,280 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include <contracts.hpp>
+
+using namespace eosio::testing;
+using namespace eosio;
+using namespace eosio::chain;
+using namespace fc;
+using namespace std;
+
+using mvo = fc::mutable_variant_object;
+
+// users routed by shard_index over { sharda, shardb, shardc }:
+// bob, dave -> sharda; alice, erin -> shardb; carol -> shardc
+class agpu_shard_tester : public tester {
+ public:
+   const name admin  = "admin"_n;
+   const name bank   = "bank"_n;
+   const name usdt   = "usdt"_n;
+   const name coord  = "coord"_n;
+   const name sharda = "sharda"_n;
+   const name shardb = "shardb"_n;
+   const name shardc = "shardc"_n;
+
+   agpu_shard_tester() {
+      produce_blocks(2);
+
+      create_accounts({ admin, bank, usdt, coord, sharda, shardb, shardc, "alice"_n, "bob"_n, "carol"_n, "dave"_n, "erin"_n });
+      produce_blocks(2);
+
+      for (const auto& contract : { coord, sharda, shardb, shardc }) {
+         set_code(contract, contracts::agpu_wasm());
+         set_abi(contract, contracts::agpu_abi().data());
+      }
+
+      // the coordinator pushes syncnode inline to its shards
+      set_authority(coord, config::active_name,
+                    authority(1, { key_weight{ get_public_key(coord, "active"), 1 } },
+                              { permission_level_weight{ { coord, config::eosio_code_name }, 1 } }),
+                    config::owner_name);
+      produce_blocks();
+
+      const auto& accnt = control->db().get<account_object, by_name>(coord);
+      abi_def     abi;
+      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
+      abi_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
+
+      for (const auto& contract : { coord, sharda, shardb, shardc }) {
+         BOOST_REQUIRE_EQUAL(success(), push_action(contract, contract, "init"_n,
+                                                    mvo()("admin", admin)("bank", bank)("usdt_contract", usdt)("usdt_symbol", "6,MUSDT")));
+      }
+
+      BOOST_REQUIRE_EQUAL(success(), push_action(coord, admin, "setshards"_n, mvo()("shards", vector<name>{ sharda, shardb, shardc })));
+      BOOST_REQUIRE_EQUAL(success(), setcoord(sharda));
+      BOOST_REQUIRE_EQUAL(success(), setcoord(shardb));
+      produce_blocks();
+   }
+
+   action_result push_action(const name& contract, const name& signer, const name& action_name, const variant_object& data) {
+      string action_type_name = abi_ser.get_action_type(action_name);
+
+      action act;
+      act.account = contract;
+      act.name    = action_name;
+      act.data    = abi_ser.variant_to_binary(action_type_name, data, abi_serializer::create_yield_function(abi_serializer_max_time));
+
+      return base_tester::push_action(std::move(act), signer.to_uint64_t());
+   }
+
+   fc::variant get_row(const name& contract, const name& scope, const name& table, const name& pk, const string& type) {
+      vector<char> data = get_row_by_account(contract, scope, table, pk);
+      return data.empty() ? fc::variant()
+                          : abi_ser.binary_to_variant(type, data, abi_serializer::create_yield_function(abi_serializer_max_time));
+   }
+
+   fc::variant get_node(const name& contract, const uint64_t& node_id) {
+      return get_row(contract, contract, "nodes"_n, name(node_id), "node_t");
+   }
+
+   fc::variant get_quota(const uint64_t& node_id, const name& shard) {
+      return get_row(coord, name(node_id), "shardquotas"_n, shard, "shard_quota_t");
+   }
+
+   action_result setcoord(const name& shard) {
+      return push_action(shard, admin, "setcoord"_n, mvo()("coordinator", coord));
+   }
+
+   action_result signup(const name& contract, const name& user) {
+      return push_action(contract, admin, "signup"_n, mvo()("user", user)("inviter", bank));
+   }
+
+   action_result addnode(const uint64_t& max_sale) {
+      const uint32_t start_time = (control->head_block_time() + fc::seconds(60)).sec_since_epoch();
+      return push_action(coord, admin, "addnode"_n,
+                         mvo()("price", "10.000000 MUSDT")("max_sale", max_sale)("start_time", start_time));
+   }
+
+   action_result setnode(const name& contract, const uint64_t& node_id, const uint64_t& max_sale) {
+      const uint32_t start_time = (control->head_block_time() + fc::seconds(60)).sec_since_epoch();
+      return push_action(contract, admin, "setnode"_n,
+                         mvo()("node_id", node_id)("price", "10.000000 MUSDT")("max_sale", max_sale)("start_time", start_time));
+   }
+
+   action_result grant(const uint64_t& node_id, const name& shard, const uint64_t& quota) {
+      return push_action(coord, admin, "grant"_n, mvo()("node_id", node_id)("shard", shard)("quota", quota));
+   }
+
+   action_result rebalance(const uint64_t& node_id, const name& from, const name& to, const uint64_t& units) {
+      return push_action(coord, admin, "rebalance"_n, mvo()("node_id", node_id)("from", from)("to", to)("units", units));
+   }
+
+   // identical actions would be one duplicate transaction within a block
+   action_result addorder(const name& contract, const uint64_t& node_id, const name& user) {
+      auto result = push_action(contract, admin, "addorder"_n, mvo()("node_id", node_id)("user", user)("quantity", "10.000000 MUSDT"));
+      produce_blocks();
+      return result;
+   }
+
+   static bool failed_with(const action_result& result, const string& message) {
+      return result != success() && result.find(message) != string::npos;
+   }
+
+   abi_serializer abi_ser;
+};
+
+BOOST_AUTO_TEST_SUITE(agpu_shard_tests)
+
+BOOST_FIXTURE_TEST_CASE(routing, agpu_shard_tester) try {
+   for (const auto& user : { "bob"_n, "dave"_n }) {
+      BOOST_REQUIRE(failed_with(signup(shardb, user), "user belongs to another shard"));
+      BOOST_REQUIRE(failed_with(signup(coord, user), "user belongs to another shard"));
+      BOOST_REQUIRE_EQUAL(success(), signup(sharda, user));
+   }
+
+   for (const auto& user : { "alice"_n, "erin"_n }) {
+      BOOST_REQUIRE(failed_with(signup(sharda, user), "user belongs to another shard"));
+      BOOST_REQUIRE_EQUAL(success(), signup(shardb, user));
+   }
+
+   BOOST_REQUIRE(failed_with(signup(sharda, "carol"_n), "user belongs to another shard"));
+   BOOST_REQUIRE(failed_with(signup(shardb, "carol"_n), "user belongs to another shard"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(grant_syncs_node, agpu_shard_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), addnode(100));
+   BOOST_REQUIRE(failed_with(push_action(sharda, admin, "addnode"_n,
+                                         mvo()("price", "10.000000 MUSDT")("max_sale", 10)("start_time", 0)),
+                             "shard nodes are synced by the coordinator"));
+
+   BOOST_REQUIRE_EQUAL(success(), grant(1, sharda, 60));
+   BOOST_REQUIRE_EQUAL(60u, get_quota(1, sharda)["quota"].as<uint64_t>());
+
+   auto node = get_node(sharda, 1);
+   BOOST_REQUIRE(!node.is_null());
+   BOOST_REQUIRE_EQUAL(60u, node["max_sale"].as<uint64_t>());
+   BOOST_REQUIRE_EQUAL(0u, node["total_saled"].as<uint64_t>());
+   BOOST_REQUIRE(get_node(shardb, 1).is_null());
+
+   BOOST_REQUIRE(failed_with(grant(1, shardb, 41), "node quota exceeded"));
+   BOOST_REQUIRE_EQUAL(success(), grant(1, shardb, 40));
+   BOOST_REQUIRE_EQUAL(40u, get_node(shardb, 1)["max_sale"].as<uint64_t>());
+
+   // granting again replaces the quota of the shard
+   BOOST_REQUIRE_EQUAL(success(), grant(1, sharda, 50));
+   BOOST_REQUIRE_EQUAL(50u, get_node(sharda, 1)["max_sale"].as<uint64_t>());
+
+   // max_sale of the coordinator covers every quota granted
+   BOOST_REQUIRE(failed_with(setnode(coord, 1, 89), "max_sale below granted quotas"));
+   BOOST_REQUIRE_EQUAL(success(), setnode(coord, 1, 90));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(shard_nodes_follow_coordinator, agpu_shard_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), addnode(100));
+   BOOST_REQUIRE_EQUAL(success(), grant(1, sharda, 60));
+
+   const string synced = "shard nodes are synced by the coordinator";
+   BOOST_REQUIRE(failed_with(setnode(sharda, 1, 10), synced));
+   BOOST_REQUIRE(failed_with(push_action(sharda, admin, "settotalsale"_n, mvo()("node_id", 1)("total_saled", 10)), synced));
+   BOOST_REQUIRE(failed_with(push_action(sharda, admin, "setnodestate"_n, mvo()("node_id", 1)("status", "disable")), synced));
+   BOOST_REQUIRE(failed_with(push_action(sharda, admin, "delnode"_n, mvo()("node_id", 1)), synced));
+   BOOST_REQUIRE(failed_with(push_action(sharda, admin, "setpricing"_n,
+                                         mvo()("node_id", 1)("curve", "linear")("base", 10000000)("step", 100000)("rate", 0)(
+                                               "tiers", vector<variant>{})),
+                             synced));
+
+   // a status change reaches the shard with the next grant
+   BOOST_REQUIRE_EQUAL(success(), push_action(coord, admin, "setnodestate"_n, mvo()("node_id", 1)("status", "disable")));
+   produce_blocks();
+   BOOST_REQUIRE_EQUAL(success(), grant(1, sharda, 60));
+   BOOST_REQUIRE_EQUAL("disable", get_node(sharda, 1)["status"].as_string());
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(syncnode_only_from_coordinator, agpu_shard_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), addnode(100));
+   BOOST_REQUIRE_EQUAL(success(), grant(1, sharda, 60));
+
+   auto forged        = mvo(get_node(sharda, 1).get_object());
+   forged["max_sale"] = 1000;
+   BOOST_REQUIRE(failed_with(push_action(sharda, admin, "syncnode"_n, mvo()("node", forged)), "missing authority of coord"));
+   BOOST_REQUIRE(failed_with(push_action(coord, coord, "syncnode"_n, mvo()("node", forged)), "not a shard"));
+   BOOST_REQUIRE_EQUAL(60u, get_node(sharda, 1)["max_sale"].as<uint64_t>());
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(shards_sell_their_own_users, agpu_shard_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), addnode(100));
+   BOOST_REQUIRE_EQUAL(success(), grant(1, sharda, 2));
+   BOOST_REQUIRE_EQUAL(success(), signup(sharda, "bob"_n));
+   BOOST_REQUIRE_EQUAL(success(), signup(shardb, "alice"_n));
+
+   BOOST_REQUIRE_EQUAL(success(), addorder(sharda, 1, "bob"_n));
+   BOOST_REQUIRE(failed_with(addorder(sharda, 1, "alice"_n), "user belongs to another shard"));
+   BOOST_REQUIRE(failed_with(addorder(shardb, 1, "alice"_n), "node not found"));
+   BOOST_REQUIRE_EQUAL(1u, get_node(sharda, 1)["total_saled"].as<uint64_t>());
+
+   BOOST_REQUIRE_EQUAL(success(), addorder(sharda, 1, "bob"_n));
+   BOOST_REQUIRE(failed_with(addorder(sharda, 1, "bob"_n), "node saled count exceeded"));
+   BOOST_REQUIRE_EQUAL(0u, get_node(coord, 1)["total_saled"].as<uint64_t>());
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(rebalance_moves_unsold_quota, agpu_shard_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), addnode(100));
+   BOOST_REQUIRE_EQUAL(success(), grant(1, sharda, 60));
+   BOOST_REQUIRE_EQUAL(success(), grant(1, shardb, 40));
+   BOOST_REQUIRE_EQUAL(success(), signup(sharda, "bob"_n));
+   BOOST_REQUIRE_EQUAL(success(), addorder(sharda, 1, "bob"_n));
+
+   BOOST_REQUIRE(failed_with(rebalance(1, sharda, shardb, 60), "unsold quota of sharda"));
+   BOOST_REQUIRE(failed_with(rebalance(1, sharda, sharda, 1), "from and to is same"));
+   BOOST_REQUIRE(failed_with(rebalance(1, shardc, shardb, 1), "no quota granted to shardc"));
+
+   BOOST_REQUIRE_EQUAL(success(), rebalance(1, sharda, shardb, 59));
+   BOOST_REQUIRE_EQUAL(1u, get_quota(1, sharda)["quota"].as<uint64_t>());
+   BOOST_REQUIRE_EQUAL(99u, get_quota(1, shardb)["quota"].as<uint64_t>());
+   BOOST_REQUIRE_EQUAL(1u, get_node(sharda, 1)["max_sale"].as<uint64_t>());
+   BOOST_REQUIRE_EQUAL(1u, get_node(sharda, 1)["total_saled"].as<uint64_t>());
+   BOOST_REQUIRE_EQUAL(99u, get_node(shardb, 1)["max_sale"].as<uint64_t>());
+
+   BOOST_REQUIRE(failed_with(addorder(sharda, 1, "bob"_n), "node saled count exceeded"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(priced_node_stays_on_coordinator, agpu_shard_tester) try {
+   BOOST_REQUIRE_EQUAL(success(), addnode(100));
+   BOOST_REQUIRE_EQUAL(success(), addnode(100));
+   BOOST_REQUIRE_EQUAL(success(), push_action(coord, admin, "setpricing"_n,
+                                              mvo()("node_id", 1)("curve", "linear")("base", 10000000)("step", 100000)("rate", 0)(
+                                                    "tiers", vector<variant>{})));
+
+   BOOST_REQUIRE(failed_with(grant(1, sharda, 10), "priced node can not be granted"));
+
+   BOOST_REQUIRE_EQUAL(success(), grant(2, sharda, 10));
+   BOOST_REQUIRE(failed_with(push_action(coord, admin, "setpricing"_n,
+                                         mvo()("node_id", 2)("curve", "linear")("base", 10000000)("step", 100000)("rate", 0)(
+                                               "tiers", vector<variant>{})),
+                             "node granted to shards"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(shard_joins_before_users, agpu_shard_tester) try {
+   // shardc is not joined yet, so it serves everyone
+   BOOST_REQUIRE_EQUAL(success(), signup(shardc, "bob"_n));
+   BOOST_REQUIRE(failed_with(setcoord(shardc), "shard already has users"));
+   BOOST_REQUIRE(failed_with(push_action(shardc, admin, "setshards"_n, mvo()("shards", vector<name>{ sharda, shardb })),
+                             "coordinator already has users"));
+
+   BOOST_REQUIRE(failed_with(setcoord(sharda), "already sharded"));
+   BOOST_REQUIRE(failed_with(push_action(sharda, admin, "setcoord"_n, mvo()("coordinator", shardb)), "already sharded"));
+}
+FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
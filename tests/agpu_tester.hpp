@@ -0,0 +1,88 @@
+#pragma once
+
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include <contracts.hpp>
+
+using namespace eosio::testing;
+using namespace eosio;
+using namespace eosio::chain;
+using namespace fc;
+using namespace std;
+
+using mvo = fc::mutable_variant_object;
+
+/// one agpu contract initialized with an admin, a bank and the MUSDT symbol
+class agpu_tester : public tester {
+ public:
+   const name agpu  = "agpu"_n;
+   const name admin = "admin"_n;
+   const name bank  = "bank"_n;
+   const name usdt  = "usdt"_n;
+
+   agpu_tester() {
+      produce_blocks(2);
+
+      create_accounts({ agpu, admin, bank, usdt, "alice"_n, "bob"_n, "carol"_n });
+      produce_blocks(2);
+
+      set_code(agpu, contracts::agpu_wasm());
+      set_abi(agpu, contracts::agpu_abi().data());
+      produce_blocks();
+
+      const auto& accnt = control->db().get<account_object, by_name>(agpu);
+      abi_def     abi;
+      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
+      abi_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
+
+      BOOST_REQUIRE_EQUAL(success(), push_action(agpu, "init"_n,
+                                                 mvo()("admin", admin)("bank", bank)("usdt_contract", usdt)("usdt_symbol", "6,MUSDT")));
+      produce_blocks();
+   }
+
+   action_result push_action(const name& signer, const name& action_name, const variant_object& data) {
+      string action_type_name = abi_ser.get_action_type(action_name);
+
+      action act;
+      act.account = agpu;
+      act.name    = action_name;
+      act.data    = abi_ser.variant_to_binary(action_type_name, data, abi_serializer::create_yield_function(abi_serializer_max_time));
+
+      return base_tester::push_action(std::move(act), signer.to_uint64_t());
+   }
+
+   fc::variant get_row(const name& table, const name& pk, const string& type) {
+      vector<char> data = get_row_by_account(agpu, agpu, table, pk);
+      return data.empty() ? fc::variant()
+                          : abi_ser.binary_to_variant(type, data, abi_serializer::create_yield_function(abi_serializer_max_time));
+   }
+
+   fc::variant get_node(const uint64_t& node_id) {
+      return get_row("nodes"_n, name(node_id), "node_t");
+   }
+
+   action_result addnode(const uint64_t& max_sale) {
+      const uint32_t start_time = (control->head_block_time() + fc::seconds(60)).sec_since_epoch();
+      return push_action(admin, "addnode"_n, mvo()("price", "10.000000 MUSDT")("max_sale", max_sale)("start_time", start_time));
+   }
+
+   action_result signup(const name& user) {
+      return push_action(admin, "signup"_n, mvo()("user", user)("inviter", bank));
+   }
+
+   // identical actions would be one duplicate transaction within a block
+   action_result addorder(const uint64_t& node_id, const name& user, const string& quantity = "10.000000 MUSDT") {
+      auto result = push_action(admin, "addorder"_n, mvo()("node_id", node_id)("user", user)("quantity", quantity));
+      produce_blocks();
+      return result;
+   }
+
+   static bool failed_with(const action_result& result, const string& message) {
+      return result != success() && result.find(message) != string::npos;
+   }
+
+   abi_serializer abi_ser;
+};